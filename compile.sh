@@ -14,7 +14,7 @@ set -o pipefail
 # just for tests
 export ASAN_OPTIONS=allocator_may_return_null=1
 
-cmake -B build -G Ninja || ctrl_c
+cmake -B build -G Ninja "$@" || ctrl_c
 ninja -C build -j $(grep -c ^processor /proc/cpuinfo) || ctrl_c
 
 rm -rf build
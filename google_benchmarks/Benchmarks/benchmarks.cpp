@@ -0,0 +1,997 @@
+// This is a personal academic project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "c_string.h"
+
+// every benchmark runs on the size classes 8 B, 64 B, 512 B, ... 16 MiB, 64 MiB
+#define SIZE_CLASSES RangeMultiplier(8)->Range(8, 64 << 20)
+
+using unique_file_ptr = std::unique_ptr<FILE, decltype(&fclose)>;
+
+static const char chunk[] = "0123456789abcdef";
+static const size_t chunk_size = sizeof(chunk) - 1;
+
+static inline size_t arg_size(const benchmark::State &state) {
+    return static_cast<size_t>(state.range(0));
+}
+
+static inline void set_processed(benchmark::State &state, size_t bytes) {
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(bytes));
+}
+
+// 'a' * (size - 1) + last, the worst case for every search
+static inline my_str_t tail_string(size_t size, char last) {
+    my_str_t str{size - 1, 'a'};
+    str.append(last);
+    return str;
+}
+
+// temporary file with `size` characters followed by '\n'
+static inline unique_file_ptr make_file(size_t size) {
+    unique_file_ptr file{std::tmpfile(), fclose};
+    if (!file)
+        throw std::runtime_error("Unable to create temporary file");
+    std::string content(size, 'f');
+    content.push_back('\n');
+    std::fwrite(content.data(), 1, content.size(), file.get());
+    std::fflush(file.get());
+    return file;
+}
+
+// temporary file of `size` bytes split into 80-byte lines
+static inline unique_file_ptr make_lines_file(size_t size) {
+    unique_file_ptr file{std::tmpfile(), fclose};
+    if (!file)
+        throw std::runtime_error("Unable to create temporary file");
+    std::string line(79, 'l');
+    line.push_back('\n');
+    for (size_t written = 0; written < size; written += line.size())
+        std::fwrite(line.data(), 1, line.size(), file.get());
+    std::fflush(file.get());
+    return file;
+}
+
+// same file, but with a name, for the path based readers; remove it with std::remove
+static inline std::string make_file_path(size_t size) {
+    char path[] = "/tmp/gbench_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1)
+        throw std::runtime_error("Unable to create temporary file");
+    close(fd);
+    auto file = make_file(size);
+    std::rewind(file.get());
+    unique_file_ptr out{std::fopen(path, "wb"), fclose};
+    if (!out)
+        throw std::runtime_error("Unable to write temporary file");
+    char buffer[1 << 16];
+    size_t read;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file.get())) > 0)
+        std::fwrite(buffer, 1, read, out.get());
+    return path;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// construction
+
+static void BM_construct_fill(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    for (auto _: state) {
+        my_str_t str{size, 'c'};
+        benchmark::DoNotOptimize(str.c_str());
+    }
+    set_processed(state, size);
+}
+BENCHMARK(BM_construct_fill)->SIZE_CLASSES;
+
+static void BM_construct_cstr(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    const std::string source(size, 'c');
+    for (auto _: state) {
+        my_str_t str{source.c_str()};
+        benchmark::DoNotOptimize(str.c_str());
+    }
+    set_processed(state, size);
+}
+BENCHMARK(BM_construct_cstr)->SIZE_CLASSES;
+
+static void BM_copy(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    const my_str_t source{size, 'c'};
+    for (auto _: state) {
+        my_str_t str{source};
+        benchmark::DoNotOptimize(str.c_str());
+    }
+    set_processed(state, size);
+}
+BENCHMARK(BM_copy)->SIZE_CLASSES;
+
+///////////////////////////////////////////////////////////////////////////////
+// append
+
+// build the whole string char by char, amortized growth included
+static void BM_append_c(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    for (auto _: state) {
+        my_str_t str{""};
+        for (size_t i = 0; i < size; ++i)
+            str.append('c');
+        benchmark::DoNotOptimize(str.c_str());
+    }
+    set_processed(state, size);
+}
+BENCHMARK(BM_append_c)->SIZE_CLASSES;
+
+// same as BM_append_c for every growth policy, second argument is my_str_growth_t
+static void BM_append_c_growth(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    const auto policy = static_cast<my_str_growth_t>(state.range(1));
+    for (auto _: state) {
+        my_str_t str{""};
+        str.set_growth_policy(policy);
+        for (size_t i = 0; i < size; ++i)
+            str.append('c');
+        benchmark::DoNotOptimize(str.c_str());
+    }
+    set_processed(state, size);
+}
+BENCHMARK(BM_append_c_growth)->ArgsProduct({
+    benchmark::CreateRange(8, 64 << 20, 8),
+    {static_cast<int64_t>(my_str_growth_t::pow2_minus_one), static_cast<int64_t>(my_str_growth_t::factor_1_5),
+     static_cast<int64_t>(my_str_growth_t::factor_2)}
+});
+// exact fit is quadratic here, so the big sizes would never finish
+BENCHMARK(BM_append_c_growth)->ArgsProduct({
+    benchmark::CreateRange(8, 32 << 10, 8),
+    {static_cast<int64_t>(my_str_growth_t::exact)}
+});
+
+// build the whole string from 16-byte pieces
+static void BM_append_cstr(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    for (auto _: state) {
+        my_str_t str{""};
+        for (size_t i = 0; i < size; i += chunk_size)
+            str.append(chunk);
+        benchmark::DoNotOptimize(str.c_str());
+    }
+    set_processed(state, size);
+}
+BENCHMARK(BM_append_cstr)->SIZE_CLASSES;
+
+// a message of four parts of the given size and two literals, append by append
+static void BM_append_chain(benchmark::State &state) {
+    const my_str_t part{arg_size(state), 'p'};
+    for (auto _: state) {
+        my_str_t str{part};
+        str.append(part);
+        str.append(": ");
+        str.append(part);
+        str.append(part);
+        str.append('\n');
+        benchmark::DoNotOptimize(str.c_str());
+    }
+    set_processed(state, 4 * part.size() + 3);
+}
+BENCHMARK(BM_append_chain)->SIZE_CLASSES;
+
+// the same message, measured first and allocated once
+static void BM_concat(benchmark::State &state) {
+    const my_str_t part{arg_size(state), 'p'};
+    for (auto _: state) {
+        my_str_t str = part + part + ": " + part + part + '\n';
+        benchmark::DoNotOptimize(str.c_str());
+    }
+    set_processed(state, 4 * part.size() + 3);
+}
+BENCHMARK(BM_concat)->SIZE_CLASSES;
+
+// hot path temporary: a 32-byte key built from pieces, on the heap and on the stack
+static void BM_key_heap(benchmark::State &state) {
+    for (auto _: state) {
+        my_str_t key{"user:"};
+        key.append(chunk);
+        key.append(":profile-v2");
+        benchmark::DoNotOptimize(key.c_str());
+    }
+}
+BENCHMARK(BM_key_heap);
+
+static void BM_key_fixed(benchmark::State &state) {
+    for (auto _: state) {
+        my_fixed_str_t<32> key{"user:"};
+        key.append(chunk);
+        key.append(":profile-v2");
+        benchmark::DoNotOptimize(key.c_str());
+    }
+}
+BENCHMARK(BM_key_fixed);
+
+///////////////////////////////////////////////////////////////////////////////
+// reserve, doubling an already filled buffer
+
+#define RESERVE_SIZES Arg(1 << 20)->Arg(64 << 20)->Arg(1 << 30)->Unit(benchmark::kMicrosecond)
+
+static void BM_reserve_grow(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    for (auto _: state) {
+        state.PauseTiming();
+        my_str_t str{size, 'c'};
+        state.ResumeTiming();
+        str.reserve(size * 2);
+        benchmark::DoNotOptimize(str.c_str());
+        state.PauseTiming();
+        {
+            my_str_t released{std::move(str)};
+        }
+        state.ResumeTiming();
+    }
+    set_processed(state, size);
+}
+BENCHMARK(BM_reserve_grow)->RESERVE_SIZES;
+
+// what reserve costs without in-place growth: allocate, copy everything, free
+static void BM_reserve_copy_baseline(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    for (auto _: state) {
+        state.PauseTiming();
+        auto old_data = std::make_unique<char[]>(size + 1);
+        std::memset(old_data.get(), 'c', size + 1);
+        state.ResumeTiming();
+        auto new_data = std::unique_ptr<char[]>(new char[size * 2 + 1]);
+        std::memcpy(new_data.get(), old_data.get(), size + 1);
+        old_data.reset();
+        benchmark::DoNotOptimize(new_data.get());
+        state.PauseTiming();
+        new_data.reset();
+        state.ResumeTiming();
+    }
+    set_processed(state, size);
+}
+BENCHMARK(BM_reserve_copy_baseline)->RESERVE_SIZES;
+
+///////////////////////////////////////////////////////////////////////////////
+// insert / erase at the front, the worst case for the tail shift.
+// PauseTiming costs more than a small edit, so it is paid once per batch of edits
+
+static const size_t edit_batch = 64;
+
+static void BM_insert(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    my_str_t str{size, 'c'};
+    for (auto _: state) {
+        for (size_t i = 0; i < edit_batch; ++i)
+            str.insert(0, chunk);
+        state.PauseTiming();
+        str.erase(0, edit_batch * chunk_size);
+        state.ResumeTiming();
+    }
+    set_processed(state, edit_batch * size);
+}
+BENCHMARK(BM_insert)->SIZE_CLASSES;
+
+static void BM_erase(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    my_str_t str{size, 'c'};
+    const my_str_t batch{edit_batch * chunk_size, 'e'};
+    for (auto _: state) {
+        state.PauseTiming();
+        str.insert(0, batch);
+        state.ResumeTiming();
+        for (size_t i = 0; i < edit_batch; ++i)
+            str.erase(0, chunk_size);
+    }
+    set_processed(state, edit_batch * size);
+}
+BENCHMARK(BM_erase)->SIZE_CLASSES;
+
+// the same front edits on a rope, compare with BM_insert and BM_erase
+static void BM_rope_insert(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    const my_str_t text{size, 'c'};
+    my_rope_t rope{text.view()};
+    for (auto _: state) {
+        for (size_t i = 0; i < edit_batch; ++i)
+            rope.insert(0, my_str_view_t{chunk, chunk_size});
+        state.PauseTiming();
+        rope.erase(0, edit_batch * chunk_size);
+        state.ResumeTiming();
+    }
+    set_processed(state, edit_batch * size);
+}
+BENCHMARK(BM_rope_insert)->SIZE_CLASSES;
+
+static void BM_rope_erase(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    const my_str_t text{size, 'c'};
+    const my_str_t batch{edit_batch * chunk_size, 'e'};
+    my_rope_t rope{text.view()};
+    for (auto _: state) {
+        state.PauseTiming();
+        rope.insert(0, batch.view());
+        state.ResumeTiming();
+        for (size_t i = 0; i < edit_batch; ++i)
+            rope.erase(0, chunk_size);
+    }
+    set_processed(state, edit_batch * size);
+}
+BENCHMARK(BM_rope_erase)->SIZE_CLASSES;
+
+static void BM_substr(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    const my_str_t str{size, 'c'};
+    for (auto _: state) {
+        my_str_t sub = str.substr(size / 4, size / 2);
+        benchmark::DoNotOptimize(sub.c_str());
+    }
+    set_processed(state, size / 2);
+}
+BENCHMARK(BM_substr)->SIZE_CLASSES;
+
+///////////////////////////////////////////////////////////////////////////////
+// in-place transforms over mixed case text, applied back and forth so the work never becomes a no-op
+
+static inline my_str_t mixed_case_string(size_t size) {
+    my_str_t str{""};
+    str.reserve(size);
+    for (size_t i = 0; i < size; ++i)
+        str.append(static_cast<char>(i % 3 ? 'a' + i % 26 : 'A' + i % 26));
+    return str;
+}
+
+// the old way, one checked access per character
+static void BM_to_lower_at(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    my_str_t str = mixed_case_string(size);
+    for (auto _: state) {
+        for (size_t i = 0; i < str.size(); ++i) {
+            char symbol = str.at(i);
+            if (symbol >= 'A' && symbol <= 'Z')
+                str.at(i) = static_cast<char>(symbol - 'A' + 'a');
+        }
+        benchmark::DoNotOptimize(str.c_str());
+        str[0] = 'A';
+    }
+    set_processed(state, size);
+}
+BENCHMARK(BM_to_lower_at)->SIZE_CLASSES;
+
+static void BM_to_lower(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    my_str_t str = mixed_case_string(size);
+    for (auto _: state) {
+        str.to_lower();
+        benchmark::DoNotOptimize(str.c_str());
+        str[0] = 'A';
+    }
+    set_processed(state, size);
+}
+BENCHMARK(BM_to_lower)->SIZE_CLASSES;
+
+static void BM_to_upper(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    my_str_t str = mixed_case_string(size);
+    for (auto _: state) {
+        str.to_upper();
+        benchmark::DoNotOptimize(str.c_str());
+        str[0] = 'a';
+    }
+    set_processed(state, size);
+}
+BENCHMARK(BM_to_upper)->SIZE_CLASSES;
+
+static void BM_replace_all(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    my_str_t str = mixed_case_string(size);
+    for (auto _: state) {
+        str.replace_all('a', 'b');
+        str.replace_all('b', 'a');
+        benchmark::DoNotOptimize(str.c_str());
+    }
+    set_processed(state, 2 * size);
+}
+BENCHMARK(BM_replace_all)->SIZE_CLASSES;
+
+static void BM_translate(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    my_str_t str = mixed_case_string(size);
+    char table[256];
+    for (int i = 0; i < 256; ++i)
+        table[i] = static_cast<char>(i ^ 1);
+    for (auto _: state) {
+        str.translate(table);
+        benchmark::DoNotOptimize(str.c_str());
+    }
+    set_processed(state, size);
+}
+BENCHMARK(BM_translate)->SIZE_CLASSES;
+
+// 64 blanks on each side. A batch of padded strings is trimmed per iteration and refilled
+// outside of the timing, the batch is smaller for big strings where PauseTiming is cheap anyway
+static void BM_trim(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    const my_str_t padded = std::string(64, ' ') + std::string(size, 't') + std::string(64, '\n');
+    const size_t batch = std::clamp<size_t>((1 << 20) / size, 1, edit_batch);
+    std::vector<my_str_t> strs(batch, padded);
+    for (auto _: state) {
+        for (auto &str: strs) {
+            str.trim();
+            benchmark::DoNotOptimize(str.c_str());
+        }
+        state.PauseTiming();
+        for (auto &str: strs)
+            str = padded;
+        state.ResumeTiming();
+    }
+    set_processed(state, batch * size);
+}
+BENCHMARK(BM_trim)->SIZE_CLASSES;
+
+///////////////////////////////////////////////////////////////////////////////
+// search, every one hits only at the very end of the string
+
+static void BM_find_c(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    const my_str_t str = tail_string(size, 'b');
+    for (auto _: state)
+        benchmark::DoNotOptimize(str.find('b', 0));
+    set_processed(state, size);
+}
+BENCHMARK(BM_find_c)->SIZE_CLASSES;
+
+// "aaaaaaab" in "aaa...aab" makes a naive search quadratic
+static void BM_find(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    const my_str_t str = tail_string(size, 'b');
+    for (auto _: state)
+        benchmark::DoNotOptimize(str.find("aaaaaaab", 0));
+    set_processed(state, size);
+}
+BENCHMARK(BM_find)->SIZE_CLASSES;
+
+// long periodic needle, tables are built once outside the loop
+static void BM_find_searcher(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    const my_str_t str = tail_string(size, 'b');
+    const std::string needle = std::string(63, 'a') + "b";
+    const my_str_searcher_t searcher{needle.c_str()};
+    for (auto _: state)
+        benchmark::DoNotOptimize(str.find(searcher, 0));
+    set_processed(state, size);
+}
+BENCHMARK(BM_find_searcher)->SIZE_CLASSES;
+
+static int is_digit(int symbol) {
+    return symbol >= '0' && symbol <= '9';
+}
+
+static void BM_find_if(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    const my_str_t str = tail_string(size, '7');
+    for (auto _: state)
+        benchmark::DoNotOptimize(str.find_if(is_digit, 0));
+    set_processed(state, size);
+}
+BENCHMARK(BM_find_if)->SIZE_CLASSES;
+
+static void BM_find_if_set(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    const my_str_t str = tail_string(size, '7');
+    const my_char_set_t digits{"0123456789"};
+    for (auto _: state)
+        benchmark::DoNotOptimize(str.find_if(digits, 0));
+    set_processed(state, size);
+}
+BENCHMARK(BM_find_if_set)->SIZE_CLASSES;
+
+///////////////////////////////////////////////////////////////////////////////
+// splitting CSV-like text into fields
+
+static inline my_str_t make_csv(size_t size) {
+    my_str_t csv{""};
+    csv.reserve(size);
+    while (csv.size() < size)
+        csv.append(csv.size() % 64 < 56 ? "12345,name," : "x\n");
+    return csv;
+}
+
+// the old way, find the next delimiter and copy the field out
+static void BM_split_substr(benchmark::State &state) {
+    const my_str_t csv = make_csv(arg_size(state));
+    for (auto _: state) {
+        size_t begin = 0;
+        for (size_t pos = csv.find(',', 0); pos != SIZE_MAX; pos = csv.find(',', begin)) {
+            my_str_t field = csv.substr(begin, pos - begin);
+            benchmark::DoNotOptimize(field.c_str());
+            begin = pos + 1;
+        }
+    }
+    set_processed(state, csv.size());
+}
+BENCHMARK(BM_split_substr)->SIZE_CLASSES;
+
+static void BM_split(benchmark::State &state) {
+    const my_str_t csv = make_csv(arg_size(state));
+    for (auto _: state) {
+        for (my_str_view_t field: csv.split(','))
+            benchmark::DoNotOptimize(field.data());
+    }
+    set_processed(state, csv.size());
+}
+BENCHMARK(BM_split)->SIZE_CLASSES;
+
+static void BM_split_set(benchmark::State &state) {
+    const my_str_t csv = make_csv(arg_size(state));
+    const my_char_set_t delims{",\n"};
+    for (auto _: state) {
+        for (my_str_view_t field: csv.split(delims))
+            benchmark::DoNotOptimize(field.data());
+    }
+    set_processed(state, csv.size());
+}
+BENCHMARK(BM_split_set)->SIZE_CLASSES;
+
+///////////////////////////////////////////////////////////////////////////////
+// many keywords over 1 MiB of text, argument is the number of keywords
+
+static inline std::vector<my_str_t> make_keywords(size_t count) {
+    std::vector<my_str_t> keywords;
+    keywords.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        my_str_t keyword{""};
+        for (size_t n = i; keyword.size() < 8; n /= 16)
+            keyword.append(chunk[n % chunk_size]);
+        keywords.push_back(keyword);
+    }
+    return keywords;
+}
+
+static inline my_str_t make_text(size_t size) {
+    my_str_t text{""};
+    text.reserve(size);
+    for (size_t i = 0; text.size() < size; ++i)
+        text.append(chunk[(i * 7 + i / 13) % chunk_size]);
+    return text;
+}
+
+// the old way, one find per keyword
+static void BM_find_each(benchmark::State &state) {
+    const auto keywords = make_keywords(arg_size(state));
+    const my_str_t text = make_text(1 << 20);
+    for (auto _: state) {
+        for (const auto &keyword: keywords)
+            benchmark::DoNotOptimize(text.find(keyword.c_str(), 0));
+    }
+    set_processed(state, text.size());
+}
+BENCHMARK(BM_find_each)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kMillisecond);
+
+static void BM_matcher(benchmark::State &state) {
+    const auto keywords = make_keywords(arg_size(state));
+    std::vector<my_str_view_t> views(keywords.begin(), keywords.end());
+    const my_str_matcher_t matcher{views.data(), views.size()};
+    const my_str_t text = make_text(1 << 20);
+    for (auto _: state)
+        benchmark::DoNotOptimize(matcher.find_all(text));
+    set_processed(state, text.size());
+}
+BENCHMARK(BM_matcher)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kMillisecond);
+
+///////////////////////////////////////////////////////////////////////////////
+// compare, strings differ only in the last character
+
+static void BM_cmp(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    const my_str_t lhs = tail_string(size, 'a');
+    const my_str_t rhs = tail_string(size, 'b');
+    for (auto _: state)
+        benchmark::DoNotOptimize(lhs < rhs);
+    set_processed(state, size);
+}
+BENCHMARK(BM_cmp)->SIZE_CLASSES;
+
+// sort 24-byte keys with a common 16-byte prefix, argument is the number of keys
+static void BM_sort(benchmark::State &state) {
+    const size_t count = arg_size(state);
+    std::vector<my_str_t> keys;
+    unsigned seed = 1;
+    for (size_t i = 0; i < count; ++i) {
+        my_str_t key{"common_prefix_16"};
+        for (int j = 0; j < 8; ++j) {
+            seed = seed * 1103515245u + 12345u;
+            key.append(static_cast<char>('a' + (seed >> 16) % 26));
+        }
+        keys.push_back(std::move(key));
+    }
+    for (auto _: state) {
+        state.PauseTiming();
+        auto copy = keys;
+        state.ResumeTiming();
+        std::sort(copy.begin(), copy.end());
+        benchmark::DoNotOptimize(copy.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(count));
+}
+BENCHMARK(BM_sort)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond);
+
+///////////////////////////////////////////////////////////////////////////////
+// hashing
+
+static void BM_hash(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    const my_str_t str{size, 'h'};
+    for (auto _: state)
+        benchmark::DoNotOptimize(my_str_hash(str.view()));
+    set_processed(state, size);
+}
+BENCHMARK(BM_hash)->SIZE_CLASSES;
+
+static void BM_hash_std_string(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    const std::string str(size, 'h');
+    for (auto _: state)
+        benchmark::DoNotOptimize(std::hash<std::string>{}(str));
+    set_processed(state, size);
+}
+BENCHMARK(BM_hash_std_string)->SIZE_CLASSES;
+
+// unchanged key, the hash is computed only once
+static void BM_hash_cached(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    const my_str_t str{size, 'h'};
+    for (auto _: state)
+        benchmark::DoNotOptimize(std::hash<my_str_t>{}(str));
+    set_processed(state, size);
+}
+BENCHMARK(BM_hash_cached)->SIZE_CLASSES;
+
+///////////////////////////////////////////////////////////////////////////////
+// file reading
+
+static void BM_read_file(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    auto file = make_file(size);
+    my_str_t str{""};
+    for (auto _: state) {
+        std::rewind(file.get());
+        if (my_str_read_file(&str, file.get()) != 0)
+            state.SkipWithError("my_str_read_file failed");
+        benchmark::DoNotOptimize(str.c_str());
+    }
+    set_processed(state, size + 1);
+}
+BENCHMARK(BM_read_file)->SIZE_CLASSES;
+
+static void BM_read_file_delim(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    auto file = make_file(size);
+    my_str_t str{""};
+    for (auto _: state) {
+        std::rewind(file.get());
+        if (my_str_read_file_delim(&str, file.get(), '\n') != 0)
+            state.SkipWithError("my_str_read_file_delim failed");
+        benchmark::DoNotOptimize(str.c_str());
+    }
+    set_processed(state, size);
+}
+BENCHMARK(BM_read_file_delim)->SIZE_CLASSES;
+
+static void BM_read_file_path(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    const auto path = make_file_path(size);
+    my_str_t str{""};
+    for (auto _: state) {
+        if (my_str_read_file_path(&str, path.c_str()) != 0)
+            state.SkipWithError("my_str_read_file_path failed");
+        benchmark::DoNotOptimize(str.c_str());
+    }
+    std::remove(path.c_str());
+    set_processed(state, size + 1);
+}
+BENCHMARK(BM_read_file_path)->SIZE_CLASSES;
+
+// mapping only, plus one pass over the data so that the pages are really read
+static void BM_map_file(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    const auto path = make_file_path(size);
+    for (auto _: state) {
+        my_str_mapped_file_t file;
+        if (file.open(path.c_str()) != 0)
+            state.SkipWithError("my_str_mapped_file_t::open failed");
+        benchmark::DoNotOptimize(file.view().find('\n', 0));
+    }
+    std::remove(path.c_str());
+    set_processed(state, size + 1);
+}
+BENCHMARK(BM_map_file)->SIZE_CLASSES;
+
+///////////////////////////////////////////////////////////////////////////////
+// splitting a whole file into lines
+
+#define LINES_SIZES RangeMultiplier(8)->Range(4 << 10, 64 << 20)
+
+static void BM_read_lines_stdio(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    auto file = make_lines_file(size);
+    my_str_t line{""};
+    for (auto _: state) {
+        std::rewind(file.get());
+        size_t lines = 0;
+        while (my_str_read_file_delim(&line, file.get(), '\n') == 0 && !std::feof(file.get()))
+            ++lines;
+        benchmark::DoNotOptimize(lines);
+    }
+    set_processed(state, size);
+}
+BENCHMARK(BM_read_lines_stdio)->LINES_SIZES;
+
+static void BM_read_lines_reader(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    auto file = make_lines_file(size);
+    for (auto _: state) {
+        std::rewind(file.get());
+        my_str_reader_t reader{file.get()};
+        my_str_view_t line;
+        size_t lines = 0;
+        while (reader.next(line, '\n'))
+            ++lines;
+        benchmark::DoNotOptimize(lines);
+    }
+    set_processed(state, size);
+}
+BENCHMARK(BM_read_lines_reader)->LINES_SIZES;
+
+// the same, but every line is copied into a caller owned string
+static void BM_read_lines_reader_refill(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    auto file = make_lines_file(size);
+    my_str_t line{""};
+    for (auto _: state) {
+        std::rewind(file.get());
+        my_str_reader_t reader{file.get()};
+        size_t lines = 0;
+        while (reader.next(line, '\n'))
+            ++lines;
+        benchmark::DoNotOptimize(lines);
+    }
+    set_processed(state, size);
+}
+BENCHMARK(BM_read_lines_reader_refill)->LINES_SIZES;
+
+///////////////////////////////////////////////////////////////////////////////
+// writing many small strings, argument is the number of 32-byte strings
+
+static inline std::vector<my_str_t> make_batch(size_t count) {
+    std::vector<my_str_t> strings;
+    strings.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+        strings.emplace_back(my_str_t{32, static_cast<char>('a' + i % 26)});
+    return strings;
+}
+
+static void BM_write_file_stdio(benchmark::State &state) {
+    const auto strings = make_batch(arg_size(state));
+    unique_file_ptr file{std::fopen("/dev/null", "w"), fclose};
+    for (auto _: state) {
+        for (const auto &str: strings) {
+            my_str_write_file(&str, file.get());
+            std::fputc('\n', file.get());
+        }
+        std::fflush(file.get());
+    }
+    set_processed(state, strings.size() * 33);
+}
+BENCHMARK(BM_write_file_stdio)->RangeMultiplier(10)->Range(10, 1000000);
+
+static void BM_write_fd_batch(benchmark::State &state) {
+    const auto strings = make_batch(arg_size(state));
+    int fd = open("/dev/null", O_WRONLY);
+    for (auto _: state) {
+        if (my_str_write_fd(strings, fd, "\n") != 0)
+            state.SkipWithError("my_str_write_fd failed");
+    }
+    close(fd);
+    set_processed(state, strings.size() * 33);
+}
+BENCHMARK(BM_write_fd_batch)->RangeMultiplier(10)->Range(10, 1000000);
+
+///////////////////////////////////////////////////////////////////////////////
+// parallel search over 100000 records of 1 KiB, argument is the number of threads
+
+static void BM_batch_find(benchmark::State &state) {
+    const size_t count = 100000;
+    std::vector<my_str_t> records;
+    records.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+        records.emplace_back(tail_string(1024, 'b'));
+    my_str_thread_pool_t pool{arg_size(state)};
+    const my_str_view_t pattern{"aaaaaaab"};
+    for (auto _: state)
+        benchmark::DoNotOptimize(my_str_batch_find(pool, records.data(), records.size(), pattern));
+    set_processed(state, count * 1024);
+}
+BENCHMARK(BM_batch_find)
+        ->RangeMultiplier(2)->Range(1, std::max(1u, std::thread::hardware_concurrency()))
+        ->UseRealTime()->Unit(benchmark::kMillisecond);
+
+///////////////////////////////////////////////////////////////////////////////
+// instrumentation overhead, compare with BM_append_c and BM_insert
+
+static void BM_append_c_stats(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    my_str_stats_enable(1);
+    for (auto _: state) {
+        my_str_t str{""};
+        for (size_t i = 0; i < size; ++i)
+            str.append('c');
+        benchmark::DoNotOptimize(str.c_str());
+    }
+    my_str_stats_enable(0);
+    set_processed(state, size);
+}
+BENCHMARK(BM_append_c_stats)->SIZE_CLASSES;
+
+static void BM_insert_stats(benchmark::State &state) {
+    const size_t size = arg_size(state);
+    my_str_t str{size, 'c'};
+    my_str_stats_enable(1);
+    for (auto _: state) {
+        for (size_t i = 0; i < edit_batch; ++i)
+            str.insert(0, chunk);
+        state.PauseTiming();
+        str.erase(0, edit_batch * chunk_size);
+        state.ResumeTiming();
+    }
+    my_str_stats_enable(0);
+    set_processed(state, edit_batch * size);
+}
+BENCHMARK(BM_insert_stats)->SIZE_CLASSES;
+
+///////////////////////////////////////////////////////////////////////////////
+// numbers, 1000 of them per iteration, separated by ','
+
+static const size_t numbers_count = 1000;
+
+static inline int64_t number_at(size_t i) {
+    return static_cast<int64_t>(i * 2654435761u % 1000000007u) - 500000000;
+}
+
+static void BM_format_int_snprintf(benchmark::State &state) {
+    my_str_t str{""};
+    for (auto _: state) {
+        str.clear();
+        char buffer[32];
+        for (size_t i = 0; i < numbers_count; ++i) {
+            std::snprintf(buffer, sizeof(buffer), "%lld,", static_cast<long long>(number_at(i)));
+            str.append(buffer);
+        }
+        benchmark::DoNotOptimize(str.c_str());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * numbers_count));
+}
+BENCHMARK(BM_format_int_snprintf);
+
+static void BM_format_int(benchmark::State &state) {
+    my_str_t str{""};
+    for (auto _: state) {
+        str.clear();
+        for (size_t i = 0; i < numbers_count; ++i) {
+            str.append_number(number_at(i));
+            str.append(',');
+        }
+        benchmark::DoNotOptimize(str.c_str());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * numbers_count));
+}
+BENCHMARK(BM_format_int);
+
+// shortest round trip needs "%.17g" from snprintf
+static void BM_format_double_snprintf(benchmark::State &state) {
+    my_str_t str{""};
+    for (auto _: state) {
+        str.clear();
+        char buffer[64];
+        for (size_t i = 0; i < numbers_count; ++i) {
+            std::snprintf(buffer, sizeof(buffer), "%.17g,", static_cast<double>(number_at(i)) / 7.0);
+            str.append(buffer);
+        }
+        benchmark::DoNotOptimize(str.c_str());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * numbers_count));
+}
+BENCHMARK(BM_format_double_snprintf);
+
+static void BM_format_double(benchmark::State &state) {
+    my_str_t str{""};
+    for (auto _: state) {
+        str.clear();
+        for (size_t i = 0; i < numbers_count; ++i) {
+            str.append_number(static_cast<double>(number_at(i)) / 7.0);
+            str.append(',');
+        }
+        benchmark::DoNotOptimize(str.c_str());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * numbers_count));
+}
+BENCHMARK(BM_format_double);
+
+static inline my_str_t make_numbers(bool floating) {
+    my_str_t str{""};
+    for (size_t i = 0; i < numbers_count; ++i) {
+        if (floating)
+            str.append_number(static_cast<double>(number_at(i)) / 7.0);
+        else
+            str.append_number(number_at(i));
+        str.append(',');
+    }
+    return str;
+}
+
+static void BM_parse_int_strtoll(benchmark::State &state) {
+    const my_str_t str = make_numbers(false);
+    for (auto _: state) {
+        const char *pos = str.c_str();
+        char *end;
+        for (size_t i = 0; i < numbers_count; ++i) {
+            benchmark::DoNotOptimize(std::strtoll(pos, &end, 10));
+            pos = end + 1;
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * numbers_count));
+}
+BENCHMARK(BM_parse_int_strtoll);
+
+static void BM_parse_int(benchmark::State &state) {
+    const my_str_t str = make_numbers(false);
+    for (auto _: state) {
+        size_t pos = 0;
+        int64_t value = 0;
+        for (size_t i = 0; i < numbers_count; ++i) {
+            pos = str.from_chars(value, pos).pos + 1;
+            benchmark::DoNotOptimize(value);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * numbers_count));
+}
+BENCHMARK(BM_parse_int);
+
+static void BM_parse_double_strtod(benchmark::State &state) {
+    const my_str_t str = make_numbers(true);
+    for (auto _: state) {
+        const char *pos = str.c_str();
+        char *end;
+        for (size_t i = 0; i < numbers_count; ++i) {
+            benchmark::DoNotOptimize(std::strtod(pos, &end));
+            pos = end + 1;
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * numbers_count));
+}
+BENCHMARK(BM_parse_double_strtod);
+
+static void BM_parse_double(benchmark::State &state) {
+    const my_str_t str = make_numbers(true);
+    for (auto _: state) {
+        size_t pos = 0;
+        double value = 0;
+        for (size_t i = 0; i < numbers_count; ++i) {
+            pos = str.from_chars(value, pos).pos + 1;
+            benchmark::DoNotOptimize(value);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * numbers_count));
+}
+BENCHMARK(BM_parse_double);
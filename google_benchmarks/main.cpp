@@ -0,0 +1,31 @@
+// This is a personal academic project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <vector>
+
+// Results are always written as JSON, so two commits can be compared with
+// benchmark's tools/compare.py. Pass --benchmark_out=<file> to change the file.
+int main(int argc, char *argv[]) {
+    std::vector<char *> args{argv, argv + argc};
+    bool has_out = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--benchmark_out=", std::strlen("--benchmark_out=")) == 0)
+            has_out = true;
+    }
+    char out_arg[] = "--benchmark_out=bench_output.json";
+    char format_arg[] = "--benchmark_out_format=json";
+    if (!has_out) {
+        args.push_back(out_arg);
+        args.push_back(format_arg);
+    }
+    int args_count = static_cast<int>(args.size());
+
+    ::benchmark::Initialize(&args_count, args.data());
+    if (::benchmark::ReportUnrecognizedArguments(args_count, args.data()))
+        return 1;
+    ::benchmark::RunSpecifiedBenchmarks();
+    ::benchmark::Shutdown();
+    return 0;
+}
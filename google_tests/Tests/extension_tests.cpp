@@ -0,0 +1,2701 @@
+// This is a personal academic project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+// Specs of the extended my_str_t API. The baseline tests stay in tests.cpp,
+// this file is built into gtester_ext only when ENABLE_EXTENSIONS is ON.
+
+#include <gtest/gtest.h>
+#include <iostream>
+#include <cmath>
+#include <string>
+#include <fstream>
+#include <string>
+#include <memory>
+#include <exception>
+#include <limits>
+
+#include "c_string.h"
+
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+#include <vector>
+#include <type_traits>
+#include <memory_resource>
+#include <algorithm>
+#include <string_view>
+#include <stdexcept>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <cctype>
+#include <charconv>
+#include <utility>
+#include <compare>
+#include <filesystem>
+#include <span>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+struct access_private {
+    size_t capacity_m;
+    size_t size_m;
+    char *data_m;
+};
+
+// count every global allocation made by the library or by the tests
+static std::atomic<size_t> allocations_count{0};
+
+void *operator new(size_t size) {
+    ++allocations_count;
+    if (void *ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+// sanitizers replace the array versions too, so they must not rely on the defaults
+void *operator new[](size_t size) {
+    return ::operator new(size);
+}
+
+void operator delete[](void *ptr) noexcept {
+    ::operator delete(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+    ::operator delete(ptr);
+}
+
+// the nothrow and aligned versions too, or they are not counted and are freed by a foreign delete
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return ::operator new(size);
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return ::operator new(size, std::nothrow);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+    ::operator delete(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+    ::operator delete(ptr);
+}
+
+void *operator new(size_t size, std::align_val_t align) {
+    ++allocations_count;
+    auto alignment = static_cast<size_t>(align);
+    // aligned_alloc wants a multiple of the alignment
+    size = (size + alignment - 1) / alignment * alignment;
+    if (void *ptr = std::aligned_alloc(alignment, size ? size : alignment))
+        return ptr;
+    throw std::bad_alloc{};
+}
+
+void *operator new[](size_t size, std::align_val_t align) {
+    return ::operator new(size, align);
+}
+
+void *operator new(size_t size, std::align_val_t align, const std::nothrow_t &) noexcept {
+    try {
+        return ::operator new(size, align);
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void *operator new[](size_t size, std::align_val_t align, const std::nothrow_t &) noexcept {
+    return ::operator new(size, align, std::nothrow);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
+
+// true if the characters are stored inside the my_str_t object itself (small string optimization)
+static inline bool is_inline(const my_str_t &str) {
+    auto begin = reinterpret_cast<const char *>(&str);
+    auto data = str.c_str();
+    return data >= begin && data < begin + sizeof(my_str_t);
+}
+
+namespace {
+
+    class ClassDeclaration : public testing::Test {
+    protected:
+        ClassDeclaration() = default;
+
+        // because there are no empty constructors this year.
+        // TODO: 2023 - fix it.
+        my_str_t string_size_20 = my_str_t{20, 'c'};
+        my_str_t string_size_2 = my_str_t{2, 'c'};
+        my_str_t string_empty = my_str_t("");
+        // the longest string that still fits into the object and the shortest one that does not
+        my_str_t string_size_15 = my_str_t{15, 'c'};
+        my_str_t string_size_16 = my_str_t{16, 'c'};
+
+        void SetUp() override {
+            string_size_20 = my_str_t{20, 'c'};
+            string_size_2 = my_str_t{2, 'c'};
+            string_empty = my_str_t("");
+            string_size_15 = my_str_t{15, 'c'};
+            string_size_16 = my_str_t{16, 'c'};
+        };
+
+    };
+
+}
+
+static inline my_str_t make_heap_string() {
+    return my_str_t{100, 'm'};
+}
+
+TEST_F(ClassDeclaration, move_constructor) {
+    // vector must move elements on reallocation, so moves and swap can't throw
+    static_assert(std::is_nothrow_move_constructible<my_str_t>::value, "move constructor must be noexcept");
+    static_assert(std::is_nothrow_move_assignable<my_str_t>::value, "move assignment must be noexcept");
+    static_assert(noexcept(std::declval<my_str_t &>().swap(std::declval<my_str_t &>())), "swap must be noexcept");
+
+    // move steals the buffer
+    const char *data = string_size_20.c_str();
+    allocations_count = 0;
+    my_str_t moved{std::move(string_size_20)};
+    ASSERT_EQ(allocations_count, 0);
+    ASSERT_EQ(moved.c_str(), data);
+    ASSERT_EQ(moved.size(), 20);
+    ASSERT_EQ(moved.capacity(), 31);
+
+    // moved-from string is still valid, empty and usable
+    ASSERT_EQ(string_size_20.size(), 0);
+    ASSERT_STREQ(string_size_20.c_str(), "");
+    string_size_20.append("hello");
+    ASSERT_STREQ(string_size_20.c_str(), "hello");
+
+    // return from function
+    allocations_count = 0;
+    my_str_t returned = make_heap_string();
+    ASSERT_EQ(allocations_count, 1);
+    ASSERT_EQ(returned.size(), 100);
+}
+
+TEST_F(ClassDeclaration, move_assignment) {
+    // assigning from a temporary must not allocate
+    my_str_t temporary{40, 't'};
+    const char *data = temporary.c_str();
+    allocations_count = 0;
+    string_size_20 = std::move(temporary);
+    ASSERT_EQ(allocations_count, 0);
+    ASSERT_EQ(string_size_20.c_str(), data);
+    ASSERT_EQ(string_size_20.size(), 40);
+
+    allocations_count = 0;
+    string_size_2 = make_heap_string();
+    ASSERT_EQ(allocations_count, 1);
+    ASSERT_EQ(string_size_2.size(), 100);
+
+    // self move-assignment leaves the string valid
+    auto &self = string_size_2;
+    string_size_2 = std::move(self);
+    ASSERT_EQ(string_size_2.size(), 100);
+
+    // vector reallocation moves elements instead of copying them
+    std::vector<my_str_t> strings;
+    strings.push_back(make_heap_string());
+    data = strings[0].c_str();
+    allocations_count = 0;
+    strings.reserve(16);
+    ASSERT_EQ(allocations_count, 1);
+    ASSERT_EQ(strings[0].c_str(), data);
+}
+
+TEST_F(ClassDeclaration, swap) {
+    const char *data_20 = string_size_20.c_str();
+    allocations_count = 0;
+    string_size_20.swap(string_size_16);
+    ASSERT_EQ(allocations_count, 0);
+    ASSERT_EQ(string_size_16.c_str(), data_20);
+    ASSERT_EQ(string_size_16.size(), 20);
+    ASSERT_EQ(string_size_20.size(), 16);
+}
+
+TEST_F(ClassDeclaration, allocation_counting) {
+    // every form of the global operator new is counted, and freed by the matching delete
+    struct alignas(64) over_aligned_t {
+        char c;
+    };
+    allocations_count = 0;
+    delete new(std::nothrow) char{'n'};
+    delete[] new(std::nothrow) char[10];
+    delete new over_aligned_t{};
+    delete[] new over_aligned_t[3];
+    delete new(std::nothrow) over_aligned_t{};
+    ASSERT_EQ(allocations_count, 5);
+}
+
+TEST_F(ClassDeclaration, small_string_layout) {
+    // small string buffer must not make the object bigger than {capacity_m, size_m, data_m}
+    ASSERT_EQ(sizeof(my_str_t), sizeof(access_private));
+
+    // short strings live inside the object, with the same capacity as before
+    ASSERT_TRUE(is_inline(string_empty));
+    ASSERT_TRUE(is_inline(string_size_2));
+    ASSERT_TRUE(is_inline(string_size_15));
+    ASSERT_EQ(string_size_15.size(), 15);
+    ASSERT_EQ(string_size_15.capacity(), 15);
+    ASSERT_STREQ(string_size_15.c_str(), "ccccccccccccccc");
+
+    // first size that does not fit goes to the heap
+    ASSERT_FALSE(is_inline(string_size_16));
+    ASSERT_EQ(string_size_16.size(), 16);
+    ASSERT_EQ(string_size_16.capacity(), 31);
+    ASSERT_FALSE(is_inline(string_size_20));
+}
+
+TEST_F(ClassDeclaration, small_string_growth) {
+    // append over the boundary moves the string to the heap and keeps the content
+    string_size_15.append('d');
+    ASSERT_FALSE(is_inline(string_size_15));
+    ASSERT_EQ(string_size_15.size(), 16);
+    ASSERT_GE(string_size_15.capacity(), 16);
+    ASSERT_STREQ(string_size_15.c_str(), "cccccccccccccccd");
+
+    // insert into the inline string
+    string_size_2.insert(1, "hello");
+    ASSERT_TRUE(is_inline(string_size_2));
+    ASSERT_STREQ(string_size_2.c_str(), "chelloc");
+
+    // reserve inside the inline buffer does not allocate
+    string_empty.reserve(10);
+    ASSERT_TRUE(is_inline(string_empty));
+    ASSERT_EQ(string_empty.capacity(), 15);
+
+    // reserve over the inline buffer does
+    string_empty.reserve(16);
+    ASSERT_FALSE(is_inline(string_empty));
+    ASSERT_GE(string_empty.capacity(), 16);
+    ASSERT_EQ(string_empty.size(), 0);
+    ASSERT_STREQ(string_empty.c_str(), "");
+
+    // clear keeps the heap buffer, so capacity does not shrink
+    string_size_20.clear();
+    ASSERT_EQ(string_size_20.size(), 0);
+    ASSERT_EQ(string_size_20.capacity(), 31);
+
+    // but shrink_to_fit returns a short string into the object
+    string_size_20.append("hello");
+    string_size_20.shrink_to_fit();
+    ASSERT_TRUE(is_inline(string_size_20));
+    ASSERT_EQ(string_size_20.capacity(), 15);
+    ASSERT_STREQ(string_size_20.c_str(), "hello");
+}
+
+TEST_F(ClassDeclaration, small_string_copy_and_move) {
+    // copy of the inline string is inline and independent
+    my_str_t inline_copy{string_size_15};
+    ASSERT_TRUE(is_inline(inline_copy));
+    ASSERT_STREQ(inline_copy.c_str(), string_size_15.c_str());
+    inline_copy[0] = 'a';
+    ASSERT_EQ(string_size_15[0], 'c');
+
+    // copy of the heap string has its own heap buffer
+    my_str_t heap_copy{string_size_16};
+    ASSERT_FALSE(is_inline(heap_copy));
+    ASSERT_NE(heap_copy.c_str(), string_size_16.c_str());
+    ASSERT_STREQ(heap_copy.c_str(), string_size_16.c_str());
+
+    // assign heap string to the inline one and back
+    inline_copy = string_size_20;
+    ASSERT_FALSE(is_inline(inline_copy));
+    ASSERT_EQ(inline_copy.size(), 20);
+    heap_copy = string_size_2;
+    ASSERT_EQ(heap_copy.size(), 2);
+    ASSERT_STREQ(heap_copy.c_str(), "cc");
+
+    // moved inline string keeps its characters inside the new object
+    my_str_t inline_moved{std::move(string_size_15)};
+    ASSERT_TRUE(is_inline(inline_moved));
+    ASSERT_STREQ(inline_moved.c_str(), "ccccccccccccccc");
+
+    // moved heap string stays on the heap
+    my_str_t heap_moved{std::move(string_size_16)};
+    ASSERT_FALSE(is_inline(heap_moved));
+    ASSERT_STREQ(heap_moved.c_str(), "cccccccccccccccc");
+
+    // swap between the inline and the heap string
+    inline_moved.swap(heap_moved);
+    ASSERT_FALSE(is_inline(inline_moved));
+    ASSERT_TRUE(is_inline(heap_moved));
+    ASSERT_EQ(inline_moved.size(), 16);
+    ASSERT_EQ(heap_moved.size(), 15);
+}
+
+// long enough to cover a full 32-byte vector, the unaligned head and the scalar tail
+static inline std::string make_search_text(size_t size) {
+    std::string text;
+    for (size_t i = 0; i < size; ++i)
+        text.push_back(static_cast<char>('a' + i % 7));
+    return text;
+}
+
+static inline size_t std_find(const std::string &text, char c, size_t from) {
+    auto pos = text.find(c, from);
+    return pos == std::string::npos ? static_cast<size_t>(SIZE_MAX) : pos;
+}
+
+TEST_F(ClassDeclaration, find_c_vector_boundaries) {
+    // find in strings of every length around 16 and 32 bytes, from every position
+    for (size_t size = 0; size < 100; ++size) {
+        auto text = make_search_text(size);
+        for (size_t pos = 0; pos < size; ++pos) {
+            auto expected = text;
+            expected[pos] = 'z';
+            my_str_t str{expected};
+            for (size_t from = 0; from <= size; ++from)
+                ASSERT_EQ(str.find('z', from), std_find(expected, 'z', from)) << size << " " << pos << " " << from;
+        }
+        // miss
+        my_str_t str{text};
+        ASSERT_EQ(str.find('z', 0), static_cast<size_t>(SIZE_MAX));
+    }
+
+    // from beyond the end
+    ASSERT_EQ(string_size_20.find('c', 20), static_cast<size_t>(SIZE_MAX));
+    ASSERT_EQ(string_size_20.find('c', 21), static_cast<size_t>(SIZE_MAX));
+    ASSERT_EQ(string_size_20.find('c', SIZE_MAX), static_cast<size_t>(SIZE_MAX));
+    ASSERT_EQ(string_empty.find('c', 0), static_cast<size_t>(SIZE_MAX));
+
+    // characters above 0x7f must not be confused by signed byte comparison
+    my_str_t high{"abc\xff\x80xyz"};
+    ASSERT_EQ(high.find('\x80', 0), static_cast<size_t>(4));
+    ASSERT_EQ(high.find('\xff', 0), static_cast<size_t>(3));
+    ASSERT_EQ(high.find('\x7f', 0), static_cast<size_t>(SIZE_MAX));
+
+    // the first of many matches in a long string
+    my_str_t many{1000, 'z'};
+    ASSERT_EQ(many.find('z', 0), static_cast<size_t>(0));
+    ASSERT_EQ(many.find('z', 999), static_cast<size_t>(999));
+}
+
+static inline int is_vowel(int symbol) {
+    return symbol == 'a' || symbol == 'e' || symbol == 'i' || symbol == 'o' || symbol == 'u';
+}
+
+TEST_F(ClassDeclaration, find_if_char_set) {
+    my_char_set_t digits{"0123456789"};
+    ASSERT_TRUE(digits.contains('5'));
+    ASSERT_FALSE(digits.contains('a'));
+    ASSERT_FALSE(digits.contains('\xff'));
+    digits.add('\xff');
+    ASSERT_TRUE(digits.contains('\xff'));
+
+    // same results as the predicate version on every length and position
+    my_char_set_t vowels{"aeiou"};
+    for (size_t size = 0; size < 100; ++size) {
+        my_str_t str{std::string(size, 'x')};
+        for (size_t pos = 0; pos < size; ++pos) {
+            str[pos] = 'o';
+            for (size_t from = 0; from <= size; ++from)
+                ASSERT_EQ(str.find_if(vowels, from), str.find_if(is_vowel, from)) << size << " " << pos << " " << from;
+            str[pos] = 'x';
+        }
+        ASSERT_EQ(str.find_if(vowels, 0), static_cast<size_t>(SIZE_MAX));
+    }
+
+    // character class with high bytes
+    my_str_t text{"hello, world\xe2\x80\x94 1"};
+    ASSERT_EQ(text.find_if(digits, 0), static_cast<size_t>(16));
+    ASSERT_EQ(text.find_if(my_char_set_t{"\x80\x94"}, 0), static_cast<size_t>(13));
+    ASSERT_EQ(text.find_if(my_char_set_t{"\x80\x94"}, 14), static_cast<size_t>(14));
+    ASSERT_EQ(text.find_if(my_char_set_t{" ,"}, 0), static_cast<size_t>(5));
+
+    // empty set never matches, from beyond the end is a miss
+    ASSERT_EQ(text.find_if(my_char_set_t{""}, 0), static_cast<size_t>(SIZE_MAX));
+    ASSERT_EQ(text.find_if(digits, text.size()), static_cast<size_t>(SIZE_MAX));
+    ASSERT_EQ(text.find_if(digits, text.size() + 1), static_cast<size_t>(SIZE_MAX));
+}
+
+static inline size_t std_find(const std::string &text, const std::string &needle, size_t from) {
+    auto pos = text.find(needle, from);
+    return pos == std::string::npos || needle.empty() ? static_cast<size_t>(SIZE_MAX) : pos;
+}
+
+// deterministic text over a small alphabet, so that partial matches happen all the time
+static inline std::string make_random_text(size_t size, const char *alphabet, unsigned seed) {
+    std::string text;
+    const size_t alphabet_size = std::strlen(alphabet);
+    for (size_t i = 0; i < size; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        text.push_back(alphabet[(seed >> 16) % alphabet_size]);
+    }
+    return text;
+}
+
+TEST_F(ClassDeclaration, find_matches_std) {
+    // needle lengths around every switch point between memchr, Two-Way and Horspool
+    const size_t needle_sizes[] = {1, 2, 3, 4, 7, 8, 9, 15, 16, 17, 31, 32, 33, 64, 100, 255, 256, 257};
+    const auto text = make_random_text(5000, "ab", 1);
+    my_str_t str{text};
+
+    for (auto needle_size: needle_sizes) {
+        for (size_t start = 0; start < text.size(); start += 397) {
+            // needle taken from the text, so it is found at least once
+            auto needle = text.substr(start, needle_size);
+            my_str_searcher_t searcher{needle.c_str()};
+            ASSERT_EQ(searcher.size(), needle.size());
+            for (size_t from = 0; from < text.size(); from += 613) {
+                ASSERT_EQ(str.find(needle, from), std_find(text, needle, from)) << needle_size << " " << start << " " << from;
+                ASSERT_EQ(str.find(searcher, from), std_find(text, needle, from)) << needle_size << " " << start << " " << from;
+            }
+        }
+        // needle that is not in the text
+        std::string missing(needle_size, 'c');
+        ASSERT_EQ(str.find(missing, 0), static_cast<size_t>(SIZE_MAX));
+        ASSERT_EQ(str.find(my_str_searcher_t{missing.c_str()}, 0), static_cast<size_t>(SIZE_MAX));
+    }
+}
+
+TEST_F(ClassDeclaration, find_adversarial) {
+    // "aaa...ab" in "aaa...a" is quadratic for a naive search
+    my_str_t text{1 << 20, 'a'};
+    const std::string needle = std::string(1000, 'a') + "b";
+    my_str_searcher_t searcher{needle.c_str()};
+    ASSERT_EQ(text.find(needle, 0), static_cast<size_t>(SIZE_MAX));
+    ASSERT_EQ(text.find(searcher, 0), static_cast<size_t>(SIZE_MAX));
+
+    // the only match is at the very end
+    text.append('b');
+    ASSERT_EQ(text.find(needle, 0), text.size() - needle.size());
+    ASSERT_EQ(text.find(searcher, 0), text.size() - needle.size());
+
+    // periodic needle with a late mismatch
+    std::string periodic;
+    for (int i = 0; i < 500; ++i)
+        periodic += "ab";
+    my_str_t periodic_str{periodic + "abc" + periodic};
+    ASSERT_EQ(periodic_str.find((periodic + "c").c_str(), 0), static_cast<size_t>(2));
+    ASSERT_EQ(periodic_str.find(my_str_searcher_t{(periodic + "c").c_str()}, 0), static_cast<size_t>(2));
+}
+
+TEST_F(ClassDeclaration, searcher_reuse) {
+    my_str_t needle{"world"};
+    my_str_searcher_t searcher{needle};
+
+    // one searcher, many strings
+    ASSERT_EQ(my_str_t{"hello, world"}.find(searcher, 0), static_cast<size_t>(7));
+    ASSERT_EQ(my_str_t{"world, hello"}.find(searcher, 0), static_cast<size_t>(0));
+    ASSERT_EQ(my_str_t{"worl"}.find(searcher, 0), static_cast<size_t>(SIZE_MAX));
+    ASSERT_EQ(string_empty.find(searcher, 0), static_cast<size_t>(SIZE_MAX));
+
+    // searcher keeps its own copy of the needle
+    needle.clear();
+    ASSERT_EQ(my_str_t{"hello, world"}.find(searcher, 3), static_cast<size_t>(7));
+
+    // same edge cases as find
+    my_str_t text{"hello, world"};
+    ASSERT_EQ(text.find(searcher, text.size() - 1), static_cast<size_t>(SIZE_MAX));
+    ASSERT_EQ(text.find(searcher, 19), static_cast<size_t>(SIZE_MAX));
+    ASSERT_EQ(text.find(my_str_searcher_t{""}, 0), static_cast<size_t>(SIZE_MAX));
+    ASSERT_EQ(text.find(my_str_searcher_t{"hello, world!"}, 0), static_cast<size_t>(SIZE_MAX));
+}
+
+// memory resource that counts what goes through it
+class counting_resource : public std::pmr::memory_resource {
+public:
+    explicit counting_resource(std::pmr::memory_resource *upstream) : upstream_m{upstream} {}
+
+    size_t allocated = 0;
+    size_t deallocated = 0;
+
+private:
+    std::pmr::memory_resource *upstream_m;
+
+    void *do_allocate(size_t bytes, size_t alignment) override {
+        ++allocated;
+        return upstream_m->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *ptr, size_t bytes, size_t alignment) override {
+        ++deallocated;
+        upstream_m->deallocate(ptr, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+};
+
+TEST_F(ClassDeclaration, pmr_arena) {
+    // null upstream: anything that does not fit into the buffer throws instead of going to the heap
+    static char buffer[1 << 16];
+    std::pmr::monotonic_buffer_resource arena{buffer, sizeof(buffer), std::pmr::null_memory_resource()};
+    counting_resource counter{&arena};
+
+    allocations_count = 0;
+    {
+        pmr::my_str_t short_str{"key", &counter};
+        pmr::my_str_t long_str{100, 'c', &counter};
+        ASSERT_EQ(long_str.get_allocator().resource(), &counter);
+
+        // growth goes through the same resource
+        for (int i = 0; i < 200; ++i)
+            short_str.append('k');
+        long_str.append("hello");
+        ASSERT_EQ(short_str.size(), 203);
+        ASSERT_EQ(long_str.size(), 105);
+
+        // copy with the resource given explicitly stays in the arena
+        pmr::my_str_t copy{long_str, &counter};
+        ASSERT_EQ(copy.get_allocator().resource(), &counter);
+        ASSERT_STREQ(copy.c_str(), long_str.c_str());
+
+        // move keeps the resource
+        pmr::my_str_t moved{std::move(copy)};
+        ASSERT_EQ(moved.get_allocator().resource(), &counter);
+        ASSERT_EQ(moved.size(), 105);
+    }
+    ASSERT_EQ(allocations_count, 0);
+    ASSERT_GT(counter.allocated, 0);
+    ASSERT_EQ(counter.allocated, counter.deallocated);
+
+    // everything is released at once
+    arena.release();
+}
+
+TEST_F(ClassDeclaration, pmr_different_resources) {
+    counting_resource first{std::pmr::new_delete_resource()};
+    counting_resource second{std::pmr::new_delete_resource()};
+    {
+        pmr::my_str_t from_first{100, 'f', &first};
+        pmr::my_str_t from_second{100, 's', &second};
+
+        // buffer can't be stolen from another resource, so move assignment copies
+        from_second = std::move(from_first);
+        ASSERT_EQ(from_second.get_allocator().resource(), &second);
+        ASSERT_EQ(from_second.size(), 100);
+        ASSERT_EQ(from_second.c_str()[0], 'f');
+    }
+    ASSERT_EQ(first.allocated, first.deallocated);
+    ASSERT_EQ(second.allocated, second.deallocated);
+}
+
+static std::vector<my_str_growth_event_t> growth_events;
+
+static void record_growth(const my_str_growth_event_t &event) {
+    growth_events.push_back(event);
+}
+
+// capacity that the policy must choose when `needed` does not fit into `capacity`
+static inline size_t expected_growth(my_str_growth_t policy, size_t capacity, size_t needed) {
+    switch (policy) {
+        case my_str_growth_t::pow2_minus_one: {
+            size_t result = 1;
+            while (result - 1 < needed)
+                result <<= 1;
+            return result - 1;
+        }
+        case my_str_growth_t::factor_1_5:
+            return std::max(needed, capacity + capacity / 2);
+        case my_str_growth_t::factor_2:
+            return std::max(needed, capacity * 2);
+        case my_str_growth_t::exact:
+            return needed;
+    }
+    return 0;
+}
+
+TEST_F(ClassDeclaration, growth_policy) {
+    // default is chosen at compile time with MY_STR_DEFAULT_GROWTH
+    ASSERT_EQ(string_empty.growth_policy(), my_str_default_growth);
+    ASSERT_EQ(string_size_20.growth_policy(), my_str_default_growth);
+
+    const my_str_growth_t policies[] = {my_str_growth_t::pow2_minus_one, my_str_growth_t::factor_1_5,
+                                        my_str_growth_t::factor_2, my_str_growth_t::exact};
+    auto previous_hook = my_str_set_growth_hook(record_growth);
+    for (auto policy: policies) {
+        my_str_t str{""};
+        str.set_growth_policy(policy);
+        ASSERT_EQ(str.growth_policy(), policy);
+
+        growth_events.clear();
+        size_t capacity = str.capacity();
+        size_t reallocations = 0;
+        for (size_t i = 0; i < 1000; ++i) {
+            str.append('c');
+            if (str.capacity() != capacity) {
+                // every reallocation follows the policy and is reported to the hook
+                ASSERT_EQ(str.capacity(), expected_growth(policy, capacity, i + 1));
+                ASSERT_EQ(growth_events.size(), ++reallocations);
+                ASSERT_EQ(growth_events.back().policy, policy);
+                ASSERT_EQ(growth_events.back().old_capacity, capacity);
+                ASSERT_EQ(growth_events.back().new_capacity, str.capacity());
+                ASSERT_EQ(growth_events.back().copied_bytes, i);
+                capacity = str.capacity();
+            }
+        }
+        ASSERT_EQ(str.size(), 1000);
+        ASSERT_EQ(growth_events.size(), reallocations);
+
+        // policy does not change the constructor capacities and exact reserve
+        my_str_t constructed{20, 'c'};
+        constructed.set_growth_policy(policy);
+        ASSERT_EQ(constructed.capacity(), 31);
+        constructed.reserve(40);
+        ASSERT_EQ(constructed.capacity(), 40);
+        constructed.reserve(35);
+        ASSERT_EQ(constructed.capacity(), 40);
+    }
+    my_str_set_growth_hook(previous_hook);
+
+    // a fresh string grows with the default policy, whichever MY_STR_DEFAULT_GROWTH selects
+    my_str_t grown{15, 'c'};
+    grown.append('!');
+    ASSERT_EQ(grown.capacity(), expected_growth(my_str_default_growth, 15, 16));
+    // and the growth of at least 1.8 times is kept unless a smaller factor is asked for
+    if (my_str_default_growth == my_str_growth_t::pow2_minus_one || my_str_default_growth == my_str_growth_t::factor_2) {
+        ASSERT_GE(grown.capacity(), std::ceil(1.8f * 15));
+    }
+
+    // policy goes along with the string on copy and move
+    string_size_2.set_growth_policy(my_str_growth_t::exact);
+    my_str_t copy{string_size_2};
+    ASSERT_EQ(copy.growth_policy(), my_str_growth_t::exact);
+    my_str_t moved{std::move(copy)};
+    ASSERT_EQ(moved.growth_policy(), my_str_growth_t::exact);
+}
+
+// position dependent content, so a lost or shifted page is noticed
+static inline bool check_pattern(const my_str_t &str, size_t size) {
+    if (str.size() != size)
+        return false;
+    for (size_t i = 0; i < size; ++i) {
+        if (str[i] != static_cast<char>('a' + i % 23))
+            return false;
+    }
+    return str.c_str()[size] == '\0';
+}
+
+// built with append only, so the result has never handed out a char& (see copy_on_write_held_reference)
+static inline my_str_t make_pattern(size_t size) {
+    my_str_t str{""};
+    str.reserve(size);
+    for (size_t i = 0; i < size; ++i)
+        str.append(static_cast<char>('a' + i % 23));
+    return str;
+}
+
+TEST_F(ClassDeclaration, reserve_large_buffers) {
+    // default allocator only, pmr::my_str_t keeps using its resource, see pmr_large_buffers
+
+    // grow across the threshold
+    const size_t size = my_str_mremap_threshold - 10;
+    my_str_t str = make_pattern(size);
+    str.reserve(my_str_mremap_threshold * 2);
+    ASSERT_GE(str.capacity(), my_str_mremap_threshold * 2);
+    ASSERT_TRUE(check_pattern(str, size));
+
+    // big buffers do not go through operator new at all
+    allocations_count = 0;
+    str.reserve(my_str_mremap_threshold * 8);
+    str.reserve(my_str_mremap_threshold * 32);
+    ASSERT_EQ(allocations_count, 0);
+    ASSERT_GE(str.capacity(), my_str_mremap_threshold * 32);
+    ASSERT_TRUE(check_pattern(str, size));
+
+    // implicit growth by append and insert keeps the content
+    my_str_t appended = make_pattern(my_str_mremap_threshold);
+    for (size_t i = my_str_mremap_threshold; i < my_str_mremap_threshold * 3; ++i)
+        appended.append(static_cast<char>('a' + i % 23));
+    ASSERT_TRUE(check_pattern(appended, my_str_mremap_threshold * 3));
+    appended.insert(0, my_str_t{my_str_mremap_threshold, 'x'});
+    ASSERT_EQ(appended.size(), my_str_mremap_threshold * 4);
+    ASSERT_EQ(appended[my_str_mremap_threshold - 1], 'x');
+    ASSERT_EQ(appended[my_str_mremap_threshold], 'a');
+
+    // copy of a mapped buffer is independent, move steals it
+    my_str_t copy{str};
+    ASSERT_TRUE(check_pattern(copy, size));
+    copy[0] = 'X';
+    ASSERT_EQ(str[0], 'a');
+    const char *data = str.c_str();
+    my_str_t moved{std::move(str)};
+    ASSERT_EQ(moved.c_str(), data);
+
+    // shrink back under the threshold
+    moved.erase(100, moved.size() - 100);
+    moved.shrink_to_fit();
+    ASSERT_TRUE(check_pattern(moved, 100));
+    ASSERT_LT(moved.capacity(), my_str_mremap_threshold);
+}
+
+TEST_F(ClassDeclaration, pmr_large_buffers) {
+    // the threshold is only for the default allocator: strings with a resource
+    // always allocate through it, whatever the size
+    std::vector<char> buffer(my_str_mremap_threshold * 8);
+    std::pmr::monotonic_buffer_resource arena{buffer.data(), buffer.size(), std::pmr::null_memory_resource()};
+    counting_resource counter{&arena};
+
+    allocations_count = 0;
+    {
+        pmr::my_str_t big{my_str_mremap_threshold * 2, 'b', &counter};
+        ASSERT_EQ(big.size(), my_str_mremap_threshold * 2);
+        ASSERT_EQ(counter.allocated, 1);
+
+        // growth across the threshold stays in the arena as well
+        pmr::my_str_t grown{"g", &counter};
+        while (grown.size() <= my_str_mremap_threshold)
+            grown.append('g');
+        ASSERT_EQ(grown.c_str()[my_str_mremap_threshold], 'g');
+        ASSERT_GT(counter.allocated, 1);
+    }
+    ASSERT_EQ(allocations_count, 0);
+    ASSERT_EQ(counter.allocated, counter.deallocated);
+}
+
+TEST_F(ClassDeclaration, view) {
+    my_str_t str{"hello, world"};
+
+    // view points to the string itself, nothing is copied
+    allocations_count = 0;
+    my_str_view_t view = str.view();
+    ASSERT_EQ(view.data(), str.c_str());
+    ASSERT_EQ(view.size(), str.size());
+    my_str_view_t world = str.substr_view(7, 5);
+    ASSERT_EQ(world.data(), str.c_str() + 7);
+    ASSERT_EQ(world.size(), 5);
+    ASSERT_EQ(allocations_count, 0);
+
+    // substr_view follows substr: size is cut at the end, begin out of range throws
+    ASSERT_EQ(str.substr_view(7, 100).size(), 5);
+    ASSERT_EQ(str.substr_view(12, 1).size(), 0);
+    ASSERT_THROW(str.substr_view(13, 1), std::out_of_range);
+    ASSERT_EQ(world.substr(1, 3), my_str_view_t{"orl"});
+    ASSERT_THROW(world.substr(6, 1), std::out_of_range);
+
+    // find works the same on a string and on a view
+    ASSERT_EQ(view.find('o', 0), str.find('o', 0));
+    ASSERT_EQ(view.find('o', 5), static_cast<size_t>(8));
+    ASSERT_EQ(view.find('z', 0), static_cast<size_t>(SIZE_MAX));
+    ASSERT_EQ(view.find('o', 12), static_cast<size_t>(SIZE_MAX));
+    ASSERT_EQ(view.find(world, 0), static_cast<size_t>(7));
+    ASSERT_EQ(str.find(world, 0), static_cast<size_t>(7));
+    ASSERT_EQ(str.find(world, 8), static_cast<size_t>(SIZE_MAX));
+    ASSERT_EQ(view.find(my_str_view_t{}, 0), static_cast<size_t>(SIZE_MAX));
+
+    // views are not null terminated, the size is used everywhere
+    my_str_view_t hello = str.substr_view(0, 5);
+    ASSERT_EQ(hello.find(',', 0), static_cast<size_t>(SIZE_MAX));
+    ASSERT_EQ(hello.find(my_str_view_t{"hello,"}, 0), static_cast<size_t>(SIZE_MAX));
+    ASSERT_STREQ(my_str_t{hello}.c_str(), "hello");
+
+    // compare
+    ASSERT_EQ(hello.compare(my_str_view_t{"hello"}), 0);
+    ASSERT_LT(hello.compare(my_str_view_t{"hello, world"}), 0);
+    ASSERT_GT(world.compare(hello), 0);
+    ASSERT_TRUE(hello < world);
+    ASSERT_TRUE(hello != world);
+    ASSERT_TRUE(my_str_view_t{} == my_str_view_t{""});
+
+    // append a view
+    string_size_2.append(world);
+    ASSERT_STREQ(string_size_2.c_str(), "ccworld");
+}
+
+TEST_F(ClassDeclaration, view_string_view_interop) {
+    std::string_view std_view{"hello, world"};
+    my_str_view_t view{std_view};
+    ASSERT_EQ(view.data(), std_view.data());
+    ASSERT_EQ(view.size(), std_view.size());
+
+    const my_str_t hello{"hello"};
+    std::string_view back = hello.view();
+    ASSERT_EQ(back.data(), hello.c_str());
+    ASSERT_EQ(back, "hello");
+    ASSERT_EQ(std::string_view{view.substr(7, 5)}, "world");
+
+    my_str_t str{my_str_view_t{std_view.substr(0, 5)}};
+    ASSERT_STREQ(str.c_str(), "hello");
+}
+
+template<typename T, typename = void>
+struct has_view : std::false_type {};
+template<typename T>
+struct has_view<T, std::void_t<decltype(std::declval<T>().view())>> : std::true_type {};
+
+template<typename T, typename = void>
+struct has_substr_view : std::false_type {};
+template<typename T>
+struct has_substr_view<T, std::void_t<decltype(std::declval<T>().substr_view(0, 1))>> : std::true_type {};
+
+// a view of a temporary would dangle (with SSO the characters die with the object), so it does not compile
+static_assert(has_view<my_str_t &>::value && has_view<const my_str_t &>::value);
+static_assert(!has_view<my_str_t>::value && !has_view<const my_str_t>::value);
+static_assert(has_substr_view<my_str_t &>::value && has_substr_view<const my_str_t &>::value);
+static_assert(!has_substr_view<my_str_t>::value && !has_substr_view<const my_str_t>::value);
+// the same holds for the implicit conversion, my_str_view_t v = my_str_t{"x"}; must not compile
+static_assert(std::is_convertible_v<my_str_t &, my_str_view_t> && std::is_convertible_v<const my_str_t &, my_str_view_t>);
+static_assert(!std::is_convertible_v<my_str_t &&, my_str_view_t> && !std::is_convertible_v<const my_str_t &&, my_str_view_t>);
+static_assert(!std::is_convertible_v<my_str_t, my_str_view_t>);
+
+TEST_F(ClassDeclaration, view_tokenize_without_allocations) {
+    // 10 MB of "token,token,..." split into views
+    const std::string token = "some_token_";
+    my_str_t buffer{""};
+    buffer.reserve(10 << 20);
+    size_t expected_tokens = 0;
+    while (buffer.size() + token.size() + 1 < buffer.capacity()) {
+        buffer.append(token.c_str());
+        buffer.append(',');
+        ++expected_tokens;
+    }
+
+    allocations_count = 0;
+    my_str_view_t rest = buffer.view();
+    size_t tokens = 0;
+    size_t total_size = 0;
+    for (size_t pos = rest.find(',', 0); pos != SIZE_MAX; pos = rest.find(',', 0)) {
+        my_str_view_t field = rest.substr(0, pos);
+        total_size += field.size();
+        ++tokens;
+        rest = rest.substr(pos + 1, SIZE_MAX);
+    }
+    ASSERT_EQ(allocations_count, 0);
+    ASSERT_EQ(tokens, expected_tokens);
+    ASSERT_EQ(total_size, expected_tokens * token.size());
+    ASSERT_TRUE(rest.empty());
+}
+
+// fresh directory in the system temp dir, removed with everything in it even when an ASSERT fails
+class temp_dir_t {
+public:
+    temp_dir_t() {
+        auto pattern = (std::filesystem::temp_directory_path() / "my_str_tests_XXXXXX").string();
+        if (!mkdtemp(pattern.data()))
+            throw std::runtime_error("Unable to create a temporary directory");
+        path_m = pattern;
+    }
+
+    ~temp_dir_t() {
+        std::error_code ignored;
+        std::filesystem::remove_all(path_m, ignored);
+    }
+
+    temp_dir_t(const temp_dir_t &) = delete;
+    temp_dir_t &operator=(const temp_dir_t &) = delete;
+
+    const std::string &path() const { return path_m; }
+
+    std::string path(const char *name) const { return path_m + "/" + name; }
+
+private:
+    std::string path_m;
+};
+
+static inline void write_test_file(const std::string &path, const std::string &content) {
+    std::ofstream out{path, std::ios::trunc | std::ios::binary};
+    if (!(out.is_open() && out.good()))
+        throw std::runtime_error("Unable to write to file");
+    out << content;
+}
+
+TEST_F(ClassDeclaration, mapped_file) {
+    temp_dir_t dir;
+    const auto path = dir.path("mapped_file.txt");
+    std::string content;
+    for (size_t i = 0; i < (8 << 20); ++i)
+        content.push_back(static_cast<char>('a' + i % 23));
+    write_test_file(path, content);
+
+    // normal read, the file is not copied to the heap
+    {
+        my_str_mapped_file_t file;
+        allocations_count = 0;
+        ASSERT_EQ(file.open(path.c_str()), 0);
+        ASSERT_EQ(allocations_count, 0);
+        ASSERT_TRUE(file.is_mapped());
+        ASSERT_EQ(file.view().size(), content.size());
+        ASSERT_TRUE(std::string_view{file.view()} == content);
+
+        // views into the mapping work like any other view
+        ASSERT_EQ(file.view().find('w', 0), static_cast<size_t>(22));
+
+        // moved mapping stays valid
+        const char *data = file.view().data();
+        my_str_mapped_file_t moved{std::move(file)};
+        ASSERT_EQ(moved.view().data(), data);
+        ASSERT_EQ(file.view().size(), 0);
+    }
+
+    // empty file can't be mapped, but it is still read
+    write_test_file(path, "");
+    {
+        my_str_mapped_file_t file;
+        ASSERT_EQ(file.open(path.c_str()), 0);
+        ASSERT_EQ(file.view().size(), 0);
+    }
+
+    // same error contract as my_str_read_file
+    {
+        my_str_mapped_file_t file;
+        ASSERT_EQ(file.open(dir.path("no_such_file.txt").c_str()), IO_READ_ERR);
+        ASSERT_EQ(file.open(dir.path().c_str()), IO_READ_ERR);
+        ASSERT_EQ(file.open(nullptr), NULL_PTR_ERR);
+        ASSERT_EQ(file.view().size(), 0);
+    }
+}
+
+TEST_F(ClassDeclaration, read_file_path) {
+    temp_dir_t dir;
+    const auto path = dir.path("read_file_path.txt");
+    write_test_file(path, "hello, \nworld");
+
+    // normal read, replaces the old content
+    ASSERT_EQ(my_str_read_file_path(&string_size_20, path.c_str()), 0);
+    ASSERT_STREQ(string_size_20.c_str(), "hello, \nworld");
+    ASSERT_EQ(string_size_20.size(), 13);
+
+    // the size is known from fstat, so the buffer is allocated once and has the right size
+    const std::string content(my_str_mremap_threshold / 2, 'b');
+    write_test_file(path, content);
+    size_t allocations = allocations_count;
+    ASSERT_EQ(my_str_read_file_path(&string_size_2, path.c_str()), 0);
+    ASSERT_EQ(allocations_count - allocations, 1);
+    ASSERT_EQ(string_size_2.size(), content.size());
+    ASSERT_LT(string_size_2.capacity(), content.size() + 4096);
+
+    // above my_str_mremap_threshold the buffer is mapped instead, still without regrowing
+    const std::string big_content(my_str_mremap_threshold * 2, 'B');
+    write_test_file(path, big_content);
+    my_str_t big{""};
+    allocations = allocations_count;
+    ASSERT_EQ(my_str_read_file_path(&big, path.c_str()), 0);
+    ASSERT_EQ(allocations_count - allocations, 0);
+    ASSERT_EQ(big.size(), big_content.size());
+    ASSERT_LT(big.capacity(), big_content.size() + 4096);
+    ASSERT_EQ(std::memcmp(big.c_str(), big_content.data(), big_content.size()), 0);
+
+    // empty file
+    write_test_file(path, "");
+    ASSERT_EQ(my_str_read_file_path(&string_size_2, path.c_str()), 0);
+    ASSERT_EQ(string_size_2.size(), 0);
+    ASSERT_STREQ(string_size_2.c_str(), "");
+
+    // errors
+    ASSERT_EQ(my_str_read_file_path(&string_size_2, dir.path("no_such_file.txt").c_str()), IO_READ_ERR);
+    ASSERT_EQ(my_str_read_file_path(&string_size_2, dir.path().c_str()), IO_READ_ERR);
+    ASSERT_EQ(my_str_read_file_path(nullptr, path.c_str()), NULL_PTR_ERR);
+    ASSERT_EQ(my_str_read_file_path(&string_size_2, nullptr), NULL_PTR_ERR);
+}
+
+using unique_file_ptr = std::unique_ptr<FILE, decltype(&fclose)>;
+
+// what std::getline gives for the same content
+static inline std::vector<std::string> split_records(const std::string &content, char delimiter) {
+    std::vector<std::string> records;
+    std::istringstream in{content};
+    std::string record;
+    while (std::getline(in, record, delimiter))
+        records.push_back(record);
+    return records;
+}
+
+static inline unique_file_ptr make_test_stream(const std::string &content) {
+    unique_file_ptr file{std::tmpfile(), fclose};
+    if (!file)
+        throw std::runtime_error("Unable to create temporary file");
+    std::fwrite(content.data(), 1, content.size(), file.get());
+    std::rewind(file.get());
+    return file;
+}
+
+TEST_F(ClassDeclaration, reader_records) {
+    const std::string contents[] = {
+            "", "\n", "a", "a\n", "hello, \nworld", "hello, \nworld\n", "\n\na\n\nbb\n", std::string(1000, 'x') + "\nshort\n",
+            make_random_text(10000, "ab\n", 7)
+    };
+    // buffers smaller than a record make records cross the buffer boundary
+    const size_t buffer_sizes[] = {1, 2, 3, 7, 64, 4096};
+
+    for (const auto &content: contents) {
+        const auto expected = split_records(content, '\n');
+        for (auto buffer_size: buffer_sizes) {
+            auto file = make_test_stream(content);
+            my_str_reader_t reader{file.get(), buffer_size};
+            std::vector<std::string> records;
+            my_str_view_t record;
+            while (reader.next(record, '\n'))
+                records.emplace_back(record.data(), record.size());
+            ASSERT_EQ(reader.status(), 0);
+            ASSERT_EQ(records, expected) << buffer_size;
+
+            // after the end it keeps returning false
+            ASSERT_FALSE(reader.next(record, '\n'));
+        }
+    }
+
+    // other delimiters
+    auto file = make_test_stream("a,b,,c");
+    my_str_reader_t reader{file.get(), 2};
+    my_str_view_t record;
+    ASSERT_TRUE(reader.next(record, ','));
+    ASSERT_EQ(std::string_view{record}, "a");
+    ASSERT_TRUE(reader.next(record, ','));
+    ASSERT_TRUE(reader.next(record, ','));
+    ASSERT_EQ(record.size(), 0);
+    ASSERT_TRUE(reader.next(record, ','));
+    ASSERT_EQ(std::string_view{record}, "c");
+    ASSERT_FALSE(reader.next(record, ','));
+}
+
+TEST_F(ClassDeclaration, reader_refill_string) {
+    std::string content;
+    for (int i = 0; i < 1000; ++i)
+        content += std::string(static_cast<size_t>(i % 50), 'r') + "\n";
+    auto file = make_test_stream(content);
+    my_str_reader_t reader{file.get(), 1 << 16};
+
+    // caller owned string with enough capacity is refilled without allocations
+    my_str_t record{""};
+    record.reserve(100);
+    const char *data = record.c_str();
+    size_t records = 0;
+    allocations_count = 0;
+    while (reader.next(record, '\n')) {
+        ASSERT_EQ(record.size(), records % 50);
+        ASSERT_EQ(record.c_str()[record.size()], '\0');
+        ++records;
+    }
+    ASSERT_EQ(allocations_count, 0);
+    ASSERT_EQ(record.c_str(), data);
+    ASSERT_EQ(records, 1000);
+    ASSERT_EQ(reader.status(), 0);
+}
+
+TEST_F(ClassDeclaration, reader_errors) {
+    // bad stream
+    temp_dir_t dir;
+    const auto path = dir.path("reader_errors.txt");
+    {
+        unique_file_ptr file{std::fopen(path.c_str(), "w"), fclose};
+        if (!file)
+            throw std::runtime_error("Unable to write to file");
+        my_str_reader_t reader{file.get()};
+        my_str_view_t record;
+        ASSERT_FALSE(reader.next(record, '\n'));
+        ASSERT_EQ(reader.status(), IO_READ_ERR);
+    }
+
+    // NULL file
+    my_str_reader_t reader{nullptr};
+    my_str_view_t record;
+    ASSERT_FALSE(reader.next(record, '\n'));
+    ASSERT_EQ(reader.status(), NULL_PTR_ERR);
+}
+
+static inline std::string read_fd(int fd) {
+    std::string content;
+    char buffer[1 << 16];
+    ssize_t read_count;
+    while ((read_count = read(fd, buffer, sizeof(buffer))) > 0)
+        content.append(buffer, static_cast<size_t>(read_count));
+    return content;
+}
+
+TEST_F(ClassDeclaration, write_fd_batch) {
+    // many more strings than fit into one writev call
+    std::vector<my_str_t> strings;
+    std::string expected;
+    std::string expected_separated;
+    for (size_t i = 0; i < 100000; ++i) {
+        strings.emplace_back(std::to_string(i).c_str());
+        expected += std::to_string(i);
+        expected_separated += std::to_string(i) + ", ";
+    }
+    strings.emplace_back("");
+    expected_separated += ", ";
+
+    temp_dir_t dir;
+    const auto path = dir.path("write_file_batch.txt");
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    ASSERT_NE(fd, -1);
+
+    // without separator
+    ASSERT_EQ(my_str_write_fd(strings, fd), 0);
+    lseek(fd, 0, SEEK_SET);
+    ASSERT_EQ(read_fd(fd), expected);
+
+    // with separator after every string
+    ASSERT_EQ(ftruncate(fd, 0), 0);
+    lseek(fd, 0, SEEK_SET);
+    ASSERT_EQ(my_str_write_fd(strings, fd, ", "), 0);
+    lseek(fd, 0, SEEK_SET);
+    ASSERT_EQ(read_fd(fd), expected_separated);
+
+    // nothing to write
+    ASSERT_EQ(ftruncate(fd, 0), 0);
+    lseek(fd, 0, SEEK_SET);
+    ASSERT_EQ(my_str_write_fd(std::span{strings}.first(0), fd, ", "), 0);
+    ASSERT_EQ(my_str_write_fd({}, fd), 0);
+    ASSERT_EQ(read_fd(fd), "");
+
+    // any contiguous range of strings, a part of one too
+    const my_str_t pair[] = {my_str_t{"a"}, my_str_t{"b"}};
+    ASSERT_EQ(my_str_write_fd(pair, fd, ";"), 0);
+    ASSERT_EQ(my_str_write_fd(std::span{strings}.subspan(10, 2), fd, ";"), 0);
+    lseek(fd, 0, SEEK_SET);
+    ASSERT_EQ(read_fd(fd), "a;b;10;11;");
+    close(fd);
+}
+
+TEST_F(ClassDeclaration, write_fd_partial_writes) {
+    // pipe takes only 64 KiB at once, so writev returns partial writes until the reader catches up
+    int pipe_fds[2];
+    ASSERT_EQ(pipe(pipe_fds), 0);
+    std::vector<my_str_t> strings;
+    for (size_t i = 0; i < 64; ++i)
+        strings.emplace_back(my_str_t{100000, static_cast<char>('a' + i % 26)});
+
+    std::string content;
+    std::thread reader{[&content, &pipe_fds] { content = read_fd(pipe_fds[0]); }};
+    int code = my_str_write_fd(strings, pipe_fds[1], "\n");
+    close(pipe_fds[1]);
+    reader.join();
+    close(pipe_fds[0]);
+
+    ASSERT_EQ(code, 0);
+    ASSERT_EQ(content.size(), 64 * 100001);
+    for (size_t i = 0; i < 64; ++i) {
+        ASSERT_EQ(content[i * 100001], static_cast<char>('a' + i % 26));
+        ASSERT_EQ(content[i * 100001 + 99999], static_cast<char>('a' + i % 26));
+        ASSERT_EQ(content[i * 100001 + 100000], '\n');
+    }
+}
+
+TEST_F(ClassDeclaration, write_fd_errors) {
+    // bad file descriptor
+    ASSERT_EQ(my_str_write_fd({&string_size_20, 1}, -1), IO_WRITE_ERR);
+
+    // descriptor opened only for reading
+    temp_dir_t dir;
+    const auto path = dir.path("write_fd_errors.txt");
+    write_test_file(path, "");
+    int fd = open(path.c_str(), O_RDONLY);
+    ASSERT_NE(fd, -1);
+    ASSERT_EQ(my_str_write_fd({&string_size_20, 1}, fd), IO_WRITE_ERR);
+    close(fd);
+}
+
+TEST_F(ClassDeclaration, rope_operations) {
+    my_rope_t rope{"hello, world"};
+    ASSERT_EQ(rope.size(), 12);
+
+    // getc / putc
+    ASSERT_EQ(rope.getc(0), 'h');
+    ASSERT_EQ(rope.getc(11), 'd');
+    ASSERT_THROW(rope.getc(12), std::out_of_range);
+    rope.putc(1, 'a');
+    ASSERT_EQ(rope.getc(1), 'a');
+    ASSERT_THROW(rope.putc(12, 'a'), std::out_of_range);
+
+    // insert at the start, inside and at the end
+    rope.insert(0, my_str_view_t{">> "});
+    rope.insert(rope.size(), '!');
+    rope.insert(8, my_str_view_t{" there"});
+    ASSERT_STREQ(rope.flatten().c_str(), ">> hallo there, world!");
+    ASSERT_THROW(rope.insert(rope.size() + 1, 'x'), std::out_of_range);
+
+    // erase
+    rope.erase(0, 3);
+    rope.erase(5, 6);
+    ASSERT_STREQ(rope.flatten().c_str(), "hallo, world!");
+    rope.erase(12, 100);
+    ASSERT_STREQ(rope.flatten().c_str(), "hallo, world");
+    ASSERT_THROW(rope.erase(13, 1), std::out_of_range);
+
+    // substr / find, same rules as my_str_t
+    ASSERT_STREQ(rope.substr(7, 100).c_str(), "world");
+    ASSERT_THROW(rope.substr(13, 1), std::out_of_range);
+    ASSERT_EQ(rope.find('o', 0), static_cast<size_t>(4));
+    ASSERT_EQ(rope.find('o', 5), static_cast<size_t>(8));
+    ASSERT_EQ(rope.find('z', 0), static_cast<size_t>(SIZE_MAX));
+    ASSERT_EQ(rope.find(my_str_view_t{"world"}, 0), static_cast<size_t>(7));
+    ASSERT_EQ(rope.find(my_str_view_t{"world"}, 8), static_cast<size_t>(SIZE_MAX));
+    ASSERT_EQ(rope.find(my_str_view_t{""}, 0), static_cast<size_t>(SIZE_MAX));
+    ASSERT_EQ(rope.find('o', 100), static_cast<size_t>(SIZE_MAX));
+
+    // empty rope
+    my_rope_t empty;
+    ASSERT_EQ(empty.size(), 0);
+    ASSERT_STREQ(empty.flatten().c_str(), "");
+    empty.insert(0, 'x');
+    ASSERT_STREQ(empty.flatten().c_str(), "x");
+}
+
+TEST_F(ClassDeclaration, rope_random_edits) {
+    // the same random edits on a rope and on std::string, so chunks get split and merged
+    std::string model = make_random_text(100000, "abcdefgh", 3);
+    my_rope_t rope{my_str_view_t{model}};
+    unsigned seed = 11;
+    auto next_random = [&seed](size_t bound) {
+        seed = seed * 1103515245u + 12345u;
+        return bound ? (seed >> 8) % bound : 0;
+    };
+
+    for (int i = 0; i < 5000; ++i) {
+        size_t pos = next_random(model.size() + 1);
+        switch (next_random(3)) {
+            case 0: {
+                auto text = make_random_text(next_random(300), "xyz", seed);
+                rope.insert(pos, my_str_view_t{text});
+                model.insert(pos, text);
+                break;
+            }
+            case 1: {
+                size_t count = next_random(300);
+                rope.erase(pos, count);
+                model.erase(pos, count);
+                break;
+            }
+            default:
+                if (pos < model.size()) {
+                    rope.putc(pos, 'Q');
+                    model[pos] = 'Q';
+                }
+        }
+        ASSERT_EQ(rope.size(), model.size());
+    }
+    ASSERT_EQ(std::string{rope.flatten().c_str()}, model);
+
+    // reads across chunk boundaries
+    for (size_t pos = 0; pos + 50 < model.size(); pos += 997) {
+        ASSERT_EQ(rope.getc(pos), model[pos]);
+        ASSERT_EQ(std::string{rope.substr(pos, 50).c_str()}, model.substr(pos, 50));
+        auto needle = model.substr(pos, 40);
+        ASSERT_EQ(rope.find(my_str_view_t{needle}, 0), std_find(model, needle, 0));
+        ASSERT_EQ(rope.find('Q', pos), std_find(model, 'Q', pos));
+    }
+}
+
+// turns the counters on for one test and leaves them off afterwards
+class StatsScope {
+public:
+    StatsScope() {
+        my_str_stats_enable(1);
+        my_str_stats_reset();
+    }
+    ~StatsScope() {
+        my_str_stats_enable(0);
+        my_str_stats_reset();
+    }
+    StatsScope(const StatsScope &) = delete;
+    StatsScope &operator=(const StatsScope &) = delete;
+};
+
+TEST_F(ClassDeclaration, rope_large_document_edits) {
+    // front edits of a big document must not move the whole text every time:
+    // the rope reports its copies in the my_str_stats_t counters like my_str_t does
+    my_str_t document{1 << 20, 'd'};
+    my_rope_t rope{document.view()};
+    my_str_stats_t stats;
+    {
+        StatsScope scope;
+        for (int i = 0; i < 2000; ++i) {
+            rope.insert(static_cast<size_t>(i), 'i');
+            rope.erase(0, 1);
+            rope.insert(0, my_str_view_t{"ab"});
+        }
+        ASSERT_EQ(my_str_stats_get(&stats), 0);
+    }
+    // a flat buffer would move 6000 MiB here, allow 16 KiB per edit
+    ASSERT_LE(stats.moved_bytes + stats.copied_bytes, 6000u * (16 << 10));
+
+    ASSERT_EQ(rope.size(), document.size() + 4000);
+    ASSERT_EQ(rope.getc(0), 'a');
+    ASSERT_EQ(rope.getc(rope.size() - 1), 'd');
+    ASSERT_EQ(rope.flatten().size(), rope.size());
+}
+
+TEST_F(ClassDeclaration, copy_on_write_sharing) {
+    // off by default: copies are deep
+    ASSERT_FALSE(string_size_20.copy_on_write());
+    my_str_t deep{string_size_20};
+    ASSERT_NE(deep.c_str(), string_size_20.c_str());
+    ASSERT_FALSE(string_size_20.is_shared());
+
+    // copies of a cow string share the buffer and do not allocate
+    my_str_t original = make_pattern(1000);
+    original.set_copy_on_write(true);
+    allocations_count = 0;
+    my_str_t copy{original};
+    my_str_t assigned{""};
+    assigned = original;
+    ASSERT_EQ(allocations_count, 0);
+    ASSERT_TRUE(copy.copy_on_write());
+    ASSERT_EQ(copy.c_str(), original.c_str());
+    ASSERT_EQ(assigned.c_str(), original.c_str());
+    ASSERT_TRUE(original.is_shared());
+
+    // reading through a const reference keeps the buffer shared
+    const my_str_t &const_copy = copy;
+    ASSERT_EQ(const_copy[10], 'k');
+    ASSERT_EQ(const_copy.find('w', 0), static_cast<size_t>(22));
+    ASSERT_EQ(const_copy.c_str(), assigned.c_str());
+
+    // short strings are stored inline and never shared
+    string_size_2.set_copy_on_write(true);
+    my_str_t short_copy{string_size_2};
+    ASSERT_TRUE(is_inline(short_copy));
+    ASSERT_FALSE(string_size_2.is_shared());
+
+    // the last owner is not shared any more
+    {
+        my_str_t temporary{original};
+    }
+    copy = my_str_t{""};
+    assigned = my_str_t{""};
+    ASSERT_FALSE(original.is_shared());
+}
+
+TEST_F(ClassDeclaration, copy_on_write_independence) {
+    // the same checks as for deep copies: a change on one side is never seen on the other.
+    // reads go through std::as_const: a non-const [] or at() would make the string unshareable,
+    // and every copy below would be deep instead of going through the unshare path
+    const my_str_t reference = make_pattern(100);
+    auto make_cow_pattern = [] {
+        my_str_t str = make_pattern(100);
+        str.set_copy_on_write(true);
+        return str;
+    };
+
+    my_str_t original = make_cow_pattern();
+    my_str_t copy{original};
+    ASSERT_TRUE(copy.is_shared());
+    copy[1] = 'X';
+    ASSERT_NE(copy.c_str(), original.c_str());
+    ASSERT_EQ(std::as_const(original)[1], 'b');
+    ASSERT_EQ(std::as_const(copy)[1], 'X');
+    ASSERT_TRUE(check_pattern(original, 100));
+
+    // a write through the original leaves the copy alone too
+    my_str_t written = make_cow_pattern();
+    copy = written;
+    ASSERT_TRUE(copy.is_shared());
+    written.at(0) = 'Y';
+    ASSERT_EQ(std::as_const(copy)[0], 'a');
+    ASSERT_EQ(std::as_const(written)[0], 'Y');
+
+    // `original` has only been read, so every copy below shares its buffer until it is changed
+    my_str_t appended{original};
+    ASSERT_TRUE(appended.is_shared());
+    appended.append('!');
+    ASSERT_NE(appended.c_str(), original.c_str());
+    ASSERT_TRUE(original == reference);
+    ASSERT_EQ(appended.size(), 101);
+
+    my_str_t inserted{original};
+    ASSERT_TRUE(inserted.is_shared());
+    inserted.insert(0, "hello");
+    ASSERT_NE(inserted.c_str(), original.c_str());
+    ASSERT_TRUE(original == reference);
+    ASSERT_EQ(std::as_const(inserted)[0], 'h');
+
+    my_str_t erased{original};
+    ASSERT_TRUE(erased.is_shared());
+    erased.erase(0, 50);
+    ASSERT_NE(erased.c_str(), original.c_str());
+    ASSERT_TRUE(original == reference);
+    ASSERT_EQ(erased.size(), 50);
+
+    my_str_t cleared{original};
+    ASSERT_TRUE(cleared.is_shared());
+    cleared.clear();
+    ASSERT_TRUE(original == reference);
+    ASSERT_EQ(cleared.size(), 0);
+    ASSERT_FALSE(original.is_shared());
+
+    // mutation of the original does not reach any of the copies
+    my_str_t first{original};
+    my_str_t second{original};
+    ASSERT_TRUE(original.is_shared());
+    original.append("tail");
+    original[0] = 'Z';
+    ASSERT_TRUE(first == reference);
+    ASSERT_TRUE(second == reference);
+    ASSERT_EQ(first.c_str(), second.c_str());
+}
+
+TEST_F(ClassDeclaration, copy_on_write_held_reference) {
+    // non-const operator[] and at() unshare the buffer and mark it unshareable:
+    // a char& may be written at any time later, so no copy may share that buffer any more
+    my_str_t str = make_pattern(100);
+    str.set_copy_on_write(true);
+    char &held = str[0];
+    my_str_t copy{str};
+    ASSERT_NE(copy.c_str(), str.c_str());
+    held = 'Z';
+    ASSERT_EQ(std::as_const(copy)[0], 'a');
+    ASSERT_EQ(std::as_const(str)[0], 'Z');
+    ASSERT_FALSE(str.is_shared());
+
+    // the same when the reference is taken while the buffer is already shared
+    my_str_t shared = make_pattern(100);
+    shared.set_copy_on_write(true);
+    my_str_t before{shared};
+    ASSERT_TRUE(shared.is_shared());
+    char &at_held = shared.at(1);
+    ASSERT_FALSE(shared.is_shared());
+    my_str_t after{shared};
+    my_str_t assigned{""};
+    assigned = shared;
+    at_held = 'Q';
+    ASSERT_EQ(std::as_const(before)[1], 'b');
+    ASSERT_EQ(std::as_const(after)[1], 'b');
+    ASSERT_EQ(std::as_const(assigned)[1], 'b');
+    ASSERT_EQ(std::as_const(shared)[1], 'Q');
+
+    // reading through a const reference hands out nothing writable, sharing goes on
+    my_str_t readonly = make_pattern(100);
+    readonly.set_copy_on_write(true);
+    ASSERT_EQ(std::as_const(readonly)[0], 'a');
+    ASSERT_EQ(std::as_const(readonly).at(1), 'b');
+    my_str_t readonly_copy{readonly};
+    ASSERT_EQ(readonly_copy.c_str(), readonly.c_str());
+}
+
+TEST_F(ClassDeclaration, copy_on_write_threads) {
+    // refcount is shared between threads, run this under TSan as well
+    my_str_t original = make_pattern(10000);
+    original.set_copy_on_write(true);
+    const my_str_t reference = make_pattern(10000);
+
+    std::vector<std::thread> threads;
+    std::atomic<int> failures{0};
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&original, &reference, &failures, t] {
+            for (int i = 0; i < 1000; ++i) {
+                my_str_t copy{original};
+                if (i % 2 == 0)
+                    copy[static_cast<size_t>(i)] = static_cast<char>('0' + t);
+                else if (!(copy == reference))
+                    ++failures;
+            }
+        });
+    }
+    for (auto &thread: threads)
+        thread.join();
+    ASSERT_EQ(failures, 0);
+    ASSERT_TRUE(original == reference);
+    ASSERT_FALSE(original.is_shared());
+}
+
+TEST_F(ClassDeclaration, pool_intern) {
+    my_str_pool_t pool{16};
+    ASSERT_EQ(pool.size(), 0);
+
+    // equal strings get the same id, different strings different ids
+    const my_str_t hello_world{"hello, world"};
+    auto hello = pool.intern(my_str_view_t{"hello"});
+    auto world = pool.intern(hello_world.substr_view(7, 5));
+    ASSERT_NE(hello, world);
+    ASSERT_EQ(pool.intern(my_str_view_t{"hello"}), hello);
+    ASSERT_EQ(pool.intern(hello_world.substr_view(0, 5)), hello);
+    ASSERT_EQ(pool.size(), 2);
+
+    // stored strings live as long as the pool, not as long as the source
+    {
+        my_str_t temporary{"temporary key"};
+        auto id = pool.intern(temporary.view());
+        temporary[0] = 'X';
+        ASSERT_EQ(std::string_view{pool.get(id)}, "temporary key");
+    }
+    ASSERT_EQ(std::string_view{pool.get(hello)}, "hello");
+    ASSERT_EQ(std::string_view{pool.get(world)}, "world");
+
+    // lookup without inserting
+    my_str_id_t found = 0;
+    ASSERT_TRUE(pool.find(my_str_view_t{"world"}, found));
+    ASSERT_EQ(found, world);
+    ASSERT_FALSE(pool.find(my_str_view_t{"missing"}, found));
+    ASSERT_EQ(pool.size(), 3);
+
+    // empty string is a normal key
+    auto empty = pool.intern(my_str_view_t{""});
+    ASSERT_EQ(pool.intern(my_str_view_t{}), empty);
+    ASSERT_EQ(pool.get(empty).size(), 0);
+
+    // unknown id
+    ASSERT_THROW(pool.get(1000), std::out_of_range);
+}
+
+TEST_F(ClassDeclaration, pool_stats) {
+    my_str_pool_t pool{16};
+    auto initial = pool.stats();
+    ASSERT_EQ(initial.strings, 0);
+    ASSERT_EQ(initial.string_bytes, 0);
+    ASSERT_GE(initial.table_slots, 16);
+
+    // table grows past the initial slots, ids stay the same
+    std::vector<my_str_id_t> ids;
+    for (int i = 0; i < 1000; ++i)
+        ids.push_back(pool.intern(my_str_view_t{"key_" + std::to_string(i)}));
+    for (int i = 0; i < 1000; ++i)
+        ASSERT_EQ(std::string_view{pool.get(ids[static_cast<size_t>(i)])}, "key_" + std::to_string(i));
+
+    auto stats = pool.stats();
+    ASSERT_EQ(stats.strings, 1000);
+    size_t bytes = 0;
+    for (int i = 0; i < 1000; ++i)
+        bytes += ("key_" + std::to_string(i)).size();
+    ASSERT_EQ(stats.string_bytes, bytes);
+    ASSERT_GE(stats.table_slots, 1000);
+    ASSERT_GE(stats.memory_used, stats.string_bytes);
+
+    // repeated keys do not use more memory
+    for (int i = 0; i < 1000; ++i)
+        pool.intern(my_str_view_t{"key_" + std::to_string(i)});
+    ASSERT_EQ(pool.stats().memory_used, stats.memory_used);
+}
+
+// ! Switch ENABLE_ASAN off in CMakeLists.txt to run this one under TSan !
+TEST_F(ClassDeclaration, pool_threads_stress) {
+    // small table, so it is resized while other threads read it
+    my_str_pool_t pool{16};
+    const int threads_count = 8;
+    const int keys_count = 5000;
+    std::vector<std::vector<my_str_id_t>> ids(threads_count, std::vector<my_str_id_t>(keys_count));
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threads_count; ++t) {
+        threads.emplace_back([&pool, &ids, t] {
+            // every thread goes through the same keys in its own order
+            for (int i = 0; i < keys_count; ++i) {
+                int key = (i * 7 + t * 613) % keys_count;
+                auto name = "symbol_" + std::to_string(key);
+                ids[static_cast<size_t>(t)][static_cast<size_t>(key)] = pool.intern(my_str_view_t{name});
+                my_str_id_t found = 0;
+                if (pool.find(my_str_view_t{name}, found) && found != ids[static_cast<size_t>(t)][static_cast<size_t>(key)])
+                    ids[static_cast<size_t>(t)][static_cast<size_t>(key)] = static_cast<my_str_id_t>(-1);
+            }
+        });
+    }
+    for (auto &thread: threads)
+        thread.join();
+
+    // all threads agree on every id
+    ASSERT_EQ(pool.size(), keys_count);
+    for (int t = 1; t < threads_count; ++t)
+        ASSERT_EQ(ids[static_cast<size_t>(t)], ids[0]);
+    for (int key = 0; key < keys_count; ++key)
+        ASSERT_EQ(std::string_view{pool.get(ids[0][static_cast<size_t>(key)])}, "symbol_" + std::to_string(key));
+}
+
+TEST_F(ClassDeclaration, hash) {
+    // equal strings, views and std::hash specializations agree
+    my_str_t str{"hello, world"};
+    ASSERT_EQ(str.hash(), my_str_hash(str.view()));
+    ASSERT_EQ(std::hash<my_str_t>{}(str), str.hash());
+    ASSERT_EQ(std::hash<my_str_view_t>{}(str.view()), str.hash());
+    ASSERT_EQ(my_str_t{"hello, world"}.hash(), str.hash());
+    ASSERT_EQ(my_str_hash(my_str_view_t{"hello"}), my_str_hash(str.substr_view(0, 5)));
+    ASSERT_EQ(string_empty.hash(), my_str_hash(my_str_view_t{}));
+
+    // one different byte anywhere in a long string changes the hash
+    const my_str_t base = make_pattern(1000);
+    for (size_t pos = 0; pos < base.size(); ++pos) {
+        my_str_t changed{base};
+        changed[pos] = '#';
+        ASSERT_NE(changed.hash(), base.hash()) << pos;
+    }
+
+    // prefixes of each other hash differently, zero bytes included
+    ASSERT_NE(my_str_hash(my_str_view_t{"\0", 1}), my_str_hash(my_str_view_t{"\0\0", 2}));
+    ASSERT_NE(my_str_hash(my_str_view_t{"a", 1}), my_str_hash(my_str_view_t{"a\0", 2}));
+
+    // no collisions on a set of similar keys
+    std::vector<size_t> hashes;
+    for (int i = 0; i < 100000; ++i)
+        hashes.push_back(my_str_hash(my_str_view_t{"key_" + std::to_string(i)}));
+    std::sort(hashes.begin(), hashes.end());
+    ASSERT_EQ(std::unique(hashes.begin(), hashes.end()), hashes.end());
+}
+
+TEST_F(ClassDeclaration, hash_cache_invalidation) {
+    // every mutator must drop the cached hash
+    my_str_t str = make_pattern(100);
+    auto is_fresh = [](const my_str_t &checked) {
+        return checked.hash() == my_str_hash(my_str_view_t{std::string{checked.c_str(), checked.size()}});
+    };
+    auto expect_fresh = [&str, &is_fresh] {
+        return is_fresh(str);
+    };
+    ASSERT_TRUE(expect_fresh());
+
+    str[3] = 'X';
+    ASSERT_TRUE(expect_fresh());
+    str.at(4) = 'Y';
+    ASSERT_TRUE(expect_fresh());
+    str.append('!');
+    ASSERT_TRUE(expect_fresh());
+    str.append("tail");
+    ASSERT_TRUE(expect_fresh());
+    str.insert(0, 'i');
+    ASSERT_TRUE(expect_fresh());
+    str.erase(0, 10);
+    ASSERT_TRUE(expect_fresh());
+    str.resize(200, 'r');
+    ASSERT_TRUE(expect_fresh());
+    str = my_str_t{"assigned"};
+    ASSERT_TRUE(expect_fresh());
+    my_str_t other{"swapped"};
+    other.hash();
+    str.swap(other);
+    ASSERT_TRUE(expect_fresh());
+    str.clear();
+    ASSERT_TRUE(expect_fresh());
+
+    // a cache taken along by a copy or kept over reserve is dropped on the next change
+    str.append("same, but long enough for the heap");
+    str.hash();
+    my_str_t copy{str};
+    copy.append('!');
+    ASSERT_TRUE(is_fresh(copy));
+    my_str_t assigned{"old content"};
+    assigned.hash();
+    assigned = str;
+    ASSERT_TRUE(is_fresh(assigned));
+    assigned.erase(0, 1);
+    ASSERT_TRUE(is_fresh(assigned));
+    str.reserve(1000);
+    str[0] = '#';
+    ASSERT_TRUE(expect_fresh());
+
+    // moved-from string is empty, the hash of its old content must not stay behind
+    str.hash();
+    my_str_t moved{std::move(str)};
+    ASSERT_TRUE(is_fresh(moved));
+    ASSERT_EQ(str.hash(), my_str_hash(my_str_view_t{}));
+}
+
+TEST_F(ClassDeclaration, hash_threads) {
+    // hash() is const, and const calls on one object may run concurrently (the standard containers
+    // rely on it): the cache must be written atomically. Run this under TSan as well
+    const my_str_t str = make_pattern(1 << 20);
+    const size_t expected = my_str_hash(my_str_view_t{std::string{str.c_str(), str.size()}});
+
+    std::vector<std::thread> threads;
+    std::atomic<int> failures{0};
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&str, &failures, expected] {
+            for (int i = 0; i < 100; ++i) {
+                if (str.hash() != expected)
+                    ++failures;
+            }
+        });
+    }
+    for (auto &thread: threads)
+        thread.join();
+    ASSERT_EQ(failures, 0);
+}
+
+TEST_F(ClassDeclaration, hash_unordered_containers) {
+    std::unordered_map<my_str_t, int> counts;
+    const char *words[] = {"a", "b", "a", "hello", "b", "a", "a long key that is stored on the heap"};
+    for (auto word: words)
+        ++counts[my_str_t{word}];
+    ASSERT_EQ(counts.size(), 4);
+    ASSERT_EQ(counts[my_str_t{"a"}], 3);
+    ASSERT_EQ(counts[my_str_t{"b"}], 2);
+    ASSERT_EQ(counts[my_str_t{"a long key that is stored on the heap"}], 1);
+}
+
+static inline int std_compare(const std::string &lhs, const std::string &rhs) {
+    int result = lhs.compare(rhs);
+    return result < 0 ? -1 : result > 0 ? 1 : 0;
+}
+
+TEST_F(ClassDeclaration, compare_word_boundaries) {
+    // first difference at every position around 8, 16 and 32 byte words, and every length difference
+    for (size_t size = 1; size < 100; ++size) {
+        const auto base = make_random_text(size, "abcdef", static_cast<unsigned>(size));
+        const my_str_t base_str{base};
+        ASSERT_EQ(base_str.compare(base_str), 0);
+        for (size_t pos = 0; pos < size; ++pos) {
+            auto greater = base;
+            greater[pos] = 'z';
+            auto high = base;
+            high[pos] = '\xf0';
+            ASSERT_EQ(base_str.compare(my_str_t{greater}), -1) << size << " " << pos;
+            ASSERT_EQ(my_str_t{greater}.compare(base_str), 1) << size << " " << pos;
+            // bytes above 0x7f compare as unsigned, like memcmp
+            ASSERT_EQ(my_str_t{high}.compare(my_str_t{greater}), 1) << size << " " << pos;
+            ASSERT_EQ(base_str.compare(high.c_str()), std_compare(base, high)) << size << " " << pos;
+
+            // prefix is smaller
+            const auto prefix = base.substr(0, pos);
+            ASSERT_EQ(my_str_t{prefix}.compare(base_str), -1);
+            ASSERT_EQ(base_str.compare(prefix.c_str()), 1);
+        }
+    }
+}
+
+TEST_F(ClassDeclaration, compare_semantics) {
+    my_str_t hello{"hello"};
+    my_str_t world{"world"};
+
+    // exactly -1, 0, 1
+    ASSERT_EQ(hello.compare(world), -1);
+    ASSERT_EQ(world.compare(hello), 1);
+    ASSERT_EQ(hello.compare(my_str_t{"hello"}), 0);
+    ASSERT_EQ(hello.compare("hello"), 0);
+    ASSERT_EQ(hello.compare("hellp"), -1);
+    ASSERT_EQ(hello.compare("hell"), 1);
+    ASSERT_EQ(string_empty.compare(""), 0);
+    ASSERT_EQ(string_empty.compare(hello), -1);
+
+    // NULL C string is equal to the empty string and less than any other, as in my_str_cmp_cstr
+    ASSERT_EQ(hello.compare(nullptr), 1);
+    ASSERT_EQ(string_empty.compare(nullptr), 0);
+
+    // my_str_t vs my_str_t uses sizes, not the terminating NUL
+    my_str_t with_zero_1{std::string{"ab\0c", 4}};
+    my_str_t with_zero_2{std::string{"ab\0d", 4}};
+    my_str_t without_zero{"ab"};
+    ASSERT_EQ(with_zero_1.compare(with_zero_2), -1);
+    ASSERT_EQ(without_zero.compare(with_zero_1), -1);
+
+    // operators agree with compare
+    ASSERT_TRUE(hello < world);
+    ASSERT_TRUE(hello <= world);
+    ASSERT_TRUE(world > hello);
+    ASSERT_TRUE(world >= hello);
+    ASSERT_TRUE(hello == my_str_t{"hello"});
+    ASSERT_TRUE(hello != world);
+    ASSERT_TRUE(with_zero_1 != with_zero_2);
+
+    // gtester is built as C++20 (see CMakeLists.txt), so this is always compiled
+    static_assert(__cpp_impl_three_way_comparison >= 201907L);
+    static_assert(std::is_same_v<decltype(hello <=> world), std::strong_ordering>);
+    ASSERT_TRUE((hello <=> world) < 0);
+    ASSERT_TRUE((world <=> hello) > 0);
+    ASSERT_TRUE((hello <=> my_str_t{"hello"}) == 0);
+    ASSERT_TRUE((with_zero_1 <=> with_zero_2) < 0);
+    ASSERT_TRUE((without_zero <=> with_zero_1) < 0);
+
+    // sorting gives the same order as std::string
+    std::vector<std::string> words;
+    for (int i = 0; i < 1000; ++i)
+        words.push_back(make_random_text(static_cast<size_t>(i % 40), "ab\xf0", static_cast<unsigned>(i)));
+    std::vector<my_str_t> strings;
+    for (const auto &word: words)
+        strings.emplace_back(word);
+    std::sort(words.begin(), words.end());
+    std::sort(strings.begin(), strings.end());
+    for (size_t i = 0; i < words.size(); ++i)
+        ASSERT_EQ(std::string(strings[i].c_str(), strings[i].size()), words[i]);
+}
+
+static inline std::vector<my_str_t> make_records(size_t count) {
+    std::vector<my_str_t> records;
+    for (size_t i = 0; i < count; ++i) {
+        // mostly short records with a few huge ones, so some threads have to steal work
+        size_t size = i % 1000 == 0 ? 100000 : 10 + i % 200;
+        records.emplace_back(make_random_text(size, "abcdefgh1", static_cast<unsigned>(i)));
+    }
+    return records;
+}
+
+TEST_F(ClassDeclaration, batch_find) {
+    const auto records = make_records(10000);
+    std::vector<my_str_view_t> views;
+    for (const auto &record: records)
+        views.push_back(record.view());
+
+    const my_str_view_t pattern{"abc"};
+    std::vector<size_t> expected;
+    for (const auto &record: records)
+        expected.push_back(record.find(pattern, 0));
+
+    // same answers as the sequential find, for any number of threads
+    for (size_t threads: {1, 2, 3, 8}) {
+        my_str_thread_pool_t pool{threads};
+        ASSERT_EQ(pool.size(), threads);
+        ASSERT_EQ(my_str_batch_find(pool, records.data(), records.size(), pattern), expected) << threads;
+        ASSERT_EQ(my_str_batch_find(pool, views.data(), views.size(), pattern), expected) << threads;
+    }
+
+    // the pool is reused between batches
+    my_str_thread_pool_t pool{4};
+    for (int i = 0; i < 10; ++i)
+        ASSERT_EQ(my_str_batch_find(pool, records.data(), records.size(), pattern), expected);
+
+    // empty collection, empty pattern
+    ASSERT_TRUE(my_str_batch_find(pool, records.data(), 0, pattern).empty());
+    auto empty_pattern = my_str_batch_find(pool, records.data(), 10, my_str_view_t{});
+    ASSERT_EQ(empty_pattern, std::vector<size_t>(10, static_cast<size_t>(SIZE_MAX)));
+}
+
+static inline int is_digit_symbol(int symbol) {
+    return symbol >= '0' && symbol <= '9';
+}
+
+TEST_F(ClassDeclaration, batch_find_if) {
+    const auto records = make_records(10000);
+    std::vector<size_t> expected;
+    for (const auto &record: records)
+        expected.push_back(record.find_if(is_digit_symbol, 0));
+
+    my_str_thread_pool_t pool{8};
+    ASSERT_EQ(my_str_batch_find_if(pool, records.data(), records.size(), is_digit_symbol), expected);
+    ASSERT_EQ(my_str_batch_find_if(pool, records.data(), records.size(), my_char_set_t{"0123456789"}), expected);
+}
+
+static inline char fold_case(char symbol) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(symbol)));
+}
+
+// every (possibly overlapping) occurrence of every pattern, the slow way
+static inline std::vector<my_str_match_t> naive_find_all(const std::vector<std::string> &patterns,
+                                                         std::string text, bool ignore_case = false) {
+    if (ignore_case)
+        std::transform(text.begin(), text.end(), text.begin(), fold_case);
+    std::vector<my_str_match_t> matches;
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        std::string pattern = patterns[i];
+        if (ignore_case)
+            std::transform(pattern.begin(), pattern.end(), pattern.begin(), fold_case);
+        if (pattern.empty())
+            continue;
+        for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1))
+            matches.push_back({i, pos});
+    }
+    return matches;
+}
+
+// matches at the same end position may come in any order
+static inline std::vector<my_str_match_t> sorted_matches(std::vector<my_str_match_t> matches) {
+    std::sort(matches.begin(), matches.end(), [](const my_str_match_t &a, const my_str_match_t &b) {
+        return a.position != b.position ? a.position < b.position : a.pattern < b.pattern;
+    });
+    return matches;
+}
+
+static inline my_str_matcher_t make_matcher(const std::vector<std::string> &patterns, bool ignore_case = false) {
+    std::vector<my_str_view_t> views(patterns.begin(), patterns.end());
+    return my_str_matcher_t{views.data(), views.size(), ignore_case};
+}
+
+TEST_F(ClassDeclaration, matcher_find_all) {
+    const std::vector<std::string> patterns{"he", "she", "his", "hers"};
+    const auto matcher = make_matcher(patterns);
+    ASSERT_EQ(matcher.size(), patterns.size());
+
+    const my_str_t ushers{"ushers"};
+    const auto matches = matcher.find_all(ushers);
+    const std::vector<my_str_match_t> expected{{1, 1}, {0, 2}, {3, 2}};
+    ASSERT_EQ(sorted_matches(matches), expected);
+    // single pass, reported in order of the end of the match
+    for (size_t i = 1; i < matches.size(); ++i)
+        ASSERT_LE(matches[i - 1].position + patterns[matches[i - 1].pattern].size(),
+                  matches[i].position + patterns[matches[i].pattern].size());
+
+    ASSERT_TRUE(matcher.find_all(my_str_view_t{}).empty());
+    ASSERT_TRUE(matcher.find_all(my_str_view_t{"abcdefg"}).empty());
+}
+
+TEST_F(ClassDeclaration, matcher_matches_naive) {
+    // thousands of short needles over a small alphabet, so that they share prefixes and suffixes
+    std::vector<std::string> patterns;
+    for (unsigned i = 0; i < 2000; ++i)
+        patterns.push_back(make_random_text(3 + i % 8, "abcdefgh", i + 1));
+    const auto matcher = make_matcher(patterns);
+
+    const auto text = make_random_text(100000, "abcdefgh", 12345);
+    const auto expected = sorted_matches(naive_find_all(patterns, text));
+    ASSERT_FALSE(expected.empty());
+    const my_str_t str{text};
+    ASSERT_EQ(sorted_matches(matcher.find_all(str)), expected);
+}
+
+TEST_F(ClassDeclaration, matcher_special_patterns) {
+    // empty patterns never match, duplicates are reported once for each index
+    const std::vector<std::string> patterns{"", "aa", "aa", "a"};
+    const auto matcher = make_matcher(patterns);
+    const std::vector<my_str_match_t> expected{{3, 0}, {1, 0}, {2, 0}, {3, 1}};
+    ASSERT_EQ(sorted_matches(matcher.find_all(my_str_view_t{"aa"})), sorted_matches(expected));
+
+    // bytes above 127 and zeros are ordinary symbols
+    const std::vector<std::string> binary{std::string{"\0\xff", 2}, "\x80"};
+    const auto binary_matcher = make_matcher(binary);
+    const std::string text{"x\0\xff\x80", 4};
+    ASSERT_EQ(sorted_matches(binary_matcher.find_all(my_str_view_t{text})), sorted_matches(naive_find_all(binary, text)));
+
+    const my_str_matcher_t nothing{nullptr, 0};
+    ASSERT_EQ(nothing.size(), 0);
+    ASSERT_TRUE(nothing.find_all(my_str_view_t{"anything"}).empty());
+}
+
+TEST_F(ClassDeclaration, matcher_ignore_case) {
+    const std::vector<std::string> patterns{"Hello", "WORLD", "o w", "1+1"};
+    const std::string text{"hello World, HELLO WORLD! 1+1"};
+
+    const auto matcher = make_matcher(patterns, true);
+    const auto expected = sorted_matches(naive_find_all(patterns, text, true));
+    ASSERT_EQ(expected.size(), 7);
+    ASSERT_EQ(sorted_matches(matcher.find_all(my_str_view_t{text})), expected);
+
+    const auto exact = make_matcher(patterns);
+    const std::vector<my_str_match_t> only_exact{{1, 19}, {3, 26}};
+    ASSERT_EQ(sorted_matches(exact.find_all(my_str_view_t{text})), only_exact);
+}
+
+TEST_F(ClassDeclaration, matcher_stream) {
+    std::vector<std::string> patterns;
+    for (unsigned i = 0; i < 100; ++i)
+        patterns.push_back(make_random_text(2 + i % 30, "ab", i + 1));
+    const auto matcher = make_matcher(patterns);
+    const auto text = make_random_text(100000, "ab", 7);
+    const auto expected = sorted_matches(matcher.find_all(my_str_view_t{text}));
+    ASSERT_EQ(expected, sorted_matches(naive_find_all(patterns, text)));
+
+    // matches that cross chunk boundaries are found, positions count from the start of the stream
+    for (size_t chunk: {1, 7, 31, 4096}) {
+        auto stream = matcher.stream();
+        std::vector<my_str_match_t> matches;
+        for (size_t pos = 0; pos < text.size(); pos += chunk)
+            stream.feed(my_str_view_t{text}.substr(pos, std::min(chunk, text.size() - pos)), matches);
+        ASSERT_EQ(stream.offset(), text.size());
+        ASSERT_EQ(sorted_matches(matches), expected) << chunk;
+    }
+
+    // the same, straight from a file
+    unique_file_ptr file{std::tmpfile(), fclose};
+    std::fwrite(text.data(), 1, text.size(), file.get());
+    std::rewind(file.get());
+    std::vector<my_str_match_t> matches;
+    ASSERT_EQ(matcher.find_all(file.get(), matches), 0);
+    ASSERT_EQ(sorted_matches(matches), expected);
+    ASSERT_EQ(matcher.find_all(nullptr, matches), NULL_PTR_ERR);
+}
+
+TEST_F(ClassDeclaration, concat_single_allocation) {
+    const my_str_t a{20, 'a'};
+    const my_str_t b{"bbb"};
+    const my_str_t c{"c"};
+    const my_str_view_t view{"view"};
+    const std::string expected = std::string(20, 'a') + "bbb" + "literal" + "c" + '!' + "view";
+
+    // the whole chain is measured first, then allocated and copied once
+    size_t allocations = allocations_count;
+    my_str_t result = a + b + "literal" + c + '!' + view;
+    ASSERT_EQ(allocations_count - allocations, 1);
+    ASSERT_EQ(result.size(), expected.size());
+    ASSERT_STREQ(result.c_str(), expected.c_str());
+
+    // building the expression itself does not allocate. Nodes may refer to their operands and to
+    // the temporary nodes below them, so an expression is used within its full-expression, never kept
+    allocations = allocations_count;
+    const size_t expression_size = (a + b + "literal").size();
+    ASSERT_EQ(allocations_count - allocations, 0);
+    ASSERT_EQ(expression_size, 30);
+
+    // short results stay inline
+    allocations = allocations_count;
+    my_str_t small = b + c + "xy";
+    ASSERT_EQ(allocations_count - allocations, 0);
+    ASSERT_STREQ(small.c_str(), "bbbcxy");
+}
+
+TEST_F(ClassDeclaration, concat_operands) {
+    const my_str_t a{"a"};
+    const my_str_t b{"b"};
+    my_str_t result = "<" + a + ',' + b + ">";
+    ASSERT_STREQ(result.c_str(), "<a,b>");
+    result = 'x' + a;
+    ASSERT_STREQ(result.c_str(), "xa");
+    result = (a + b) + (b + a);
+    ASSERT_STREQ(result.c_str(), "abba");
+    result = my_str_view_t{"v"} + a + my_str_view_t{std::string_view{"w"}};
+    ASSERT_STREQ(result.c_str(), "vaw");
+
+    // operands may be the result itself
+    result = result + result + a;
+    ASSERT_STREQ(result.c_str(), "vawvawa");
+
+    // embedded zeros are copied too
+    const my_str_t zero{1, '\0'};
+    result = a + zero + b;
+    ASSERT_EQ(result.size(), 3);
+    ASSERT_EQ(result[1], '\0');
+    ASSERT_EQ(result[2], 'b');
+}
+
+template<typename T>
+static inline std::string std_to_chars(T value) {
+    char buffer[128];
+    auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    return {buffer, static_cast<size_t>(end - buffer)};
+}
+
+TEST_F(ClassDeclaration, append_number) {
+    my_str_t str{"n="};
+    str.append_number(42);
+    str.append(',');
+    str.append_number(-7L);
+    str.append(',');
+    str.append_number(0u);
+    ASSERT_STREQ(str.c_str(), "n=42,-7,0");
+
+    // same digits as std::to_chars, shortest round trip for floating point
+    std::string expected;
+    str.clear();
+    for (auto value: {INT64_MIN, INT64_MAX, int64_t{0}, int64_t{-1}}) {
+        str.append_number(value);
+        expected += std_to_chars(value);
+    }
+    str.append_number(UINT64_MAX);
+    expected += std_to_chars(UINT64_MAX);
+    for (double value: {0.5, -0.0, 0.1, 1e300, 5e-324, 123456789.125}) {
+        str.append_number(value);
+        expected += std_to_chars(value);
+    }
+    str.append_number(1.5f);
+    expected += std_to_chars(1.5f);
+    ASSERT_EQ(str.size(), expected.size());
+    ASSERT_STREQ(str.c_str(), expected.c_str());
+
+    // digits go straight into the reserved tail
+    my_str_t reserved{""};
+    reserved.reserve(4000);
+    size_t allocations = allocations_count;
+    for (int i = 0; i < 50; ++i) {
+        reserved.append_number(i * 1000003);
+        reserved.append_number(i / 7.0);
+    }
+    ASSERT_EQ(allocations_count - allocations, 0);
+}
+
+// everything below is evaluated by the compiler
+static constexpr my_fixed_str_t<16> make_fixed_id(char number) {
+    my_fixed_str_t<16> id{"id-"};
+    id.append(number);
+    id.append(my_str_view_t{"/xyz", 4});
+    return id;
+}
+
+static_assert(make_fixed_id('7').size() == 8);
+static_assert(make_fixed_id('7').capacity() == 16);
+static_assert(make_fixed_id('7')[3] == '7');
+static_assert(make_fixed_id('7').find('/', 0) == 4);
+static_assert(make_fixed_id('7').find("xyz", 0) == 5);
+static_assert(make_fixed_id('7').find("xyzw", 0) == static_cast<size_t>(SIZE_MAX));
+static_assert(make_fixed_id('7').substr(3, 2) == "7/");
+static_assert(make_fixed_id('7').compare("id-7/xyz") == 0);
+static_assert(make_fixed_id('7').compare("id-8") == -1);
+static_assert(make_fixed_id('7') < "id-8");
+
+// lookup table built at compile time, a literal may fill the whole capacity
+static constexpr my_fixed_str_t<4> method_names[] = {"GET", "PUT", "POST"};
+static_assert(method_names[2].size() == 4 && method_names[2].capacity() == 4);
+static_assert(std::is_same_v<decltype(my_fixed_str_t{"abc"}), my_fixed_str_t<3>>);
+
+TEST_F(ClassDeclaration, fixed_string) {
+    static_assert(std::is_trivially_copyable_v<my_fixed_str_t<32>>);
+    static_assert(sizeof(my_fixed_str_t<32>) <= 32 + 1 + sizeof(size_t) + alignof(size_t));
+
+    size_t allocations = allocations_count;
+    my_fixed_str_t<32> str{"hello"};
+    str.append(' ');
+    str.append("world");
+    str.at(0) = 'H';
+    str[6] = 'W';
+    auto copy = str;
+    copy.append(my_str_view_t{"!!!"});
+    ASSERT_EQ(allocations_count - allocations, 0);
+
+    ASSERT_STREQ(str.c_str(), "Hello World");
+    ASSERT_STREQ(copy.c_str(), "Hello World!!!");
+    ASSERT_EQ(str.size(), 11);
+    ASSERT_EQ(str.capacity(), 32);
+    ASSERT_EQ(str.find("World", 0), 6);
+    ASSERT_EQ(str.find('o', 5), 7);
+    ASSERT_STREQ(str.substr(6, 100).c_str(), "World");
+    ASSERT_EQ(str.compare("Hello"), 1);
+
+    str.clear();
+    ASSERT_EQ(str.size(), 0);
+    ASSERT_STREQ(str.c_str(), "");
+}
+
+TEST_F(ClassDeclaration, fixed_string_bounds) {
+    my_fixed_str_t<4> str{"abc"};
+    ASSERT_THROW(str.at(3), std::out_of_range);
+    ASSERT_THROW(str.substr(4, 1), std::out_of_range);
+    str.append('d');
+    // never grows past its capacity, and a failed append changes nothing
+    ASSERT_THROW(str.append('e'), std::length_error);
+    ASSERT_THROW(str.append("ef"), std::length_error);
+    ASSERT_STREQ(str.c_str(), "abcd");
+    ASSERT_THROW(my_fixed_str_t<4>{my_str_view_t{"abcde"}}, std::length_error);
+}
+
+TEST_F(ClassDeclaration, fixed_string_interop) {
+    const my_str_t heap{"heap string"};
+    my_fixed_str_t<64> fixed{my_str_view_t{heap}};
+    ASSERT_EQ(fixed.compare(heap), 0);
+    fixed.append(heap.substr_view(4, 7));
+    ASSERT_STREQ(fixed.c_str(), "heap string string");
+
+    // and back, through a view
+    my_str_t copy{fixed};
+    ASSERT_EQ(copy.size(), fixed.size());
+    ASSERT_STREQ(copy.c_str(), fixed.c_str());
+    copy.append(fixed);
+    ASSERT_EQ(copy.size(), 2 * fixed.size());
+    const std::string_view view = fixed.view();
+    ASSERT_EQ(view, "heap string string");
+    ASSERT_EQ(copy.find(fixed.substr(5, 6), 0), 5);
+}
+
+static inline uint64_t total_allocations(const my_str_stats_t &stats) {
+    uint64_t total = 0;
+    for (auto count: stats.allocations)
+        total += count;
+    return total;
+}
+
+TEST_F(ClassDeclaration, stats_size_classes) {
+    // 64 B, 512 B, 4 KiB, ... 2 MiB, 16 MiB, everything bigger
+    ASSERT_EQ(my_str_stats_size_class(1), 0);
+    ASSERT_EQ(my_str_stats_size_class(64), 0);
+    ASSERT_EQ(my_str_stats_size_class(65), 1);
+    ASSERT_EQ(my_str_stats_size_class(512), 1);
+    ASSERT_EQ(my_str_stats_size_class(4096), 2);
+    ASSERT_EQ(my_str_stats_size_class(16 << 20), 6);
+    ASSERT_EQ(my_str_stats_size_class((16 << 20) + 1), MY_STR_STATS_SIZE_CLASSES - 1);
+    ASSERT_EQ(my_str_stats_size_class(SIZE_MAX), MY_STR_STATS_SIZE_CLASSES - 1);
+}
+
+TEST_F(ClassDeclaration, stats_disabled) {
+    my_str_stats_enable(0);
+    my_str_stats_reset();
+    ASSERT_EQ(my_str_stats_enabled(), 0);
+    my_str_t str{1000, 'a'};
+    str.reserve(2000);
+    str.insert(0, "xy");
+
+    my_str_stats_t stats;
+    ASSERT_EQ(my_str_stats_get(&stats), 0);
+    ASSERT_EQ(total_allocations(stats), 0);
+    ASSERT_EQ(stats.reserve_misses, 0);
+    ASSERT_EQ(stats.moved_bytes, 0);
+    ASSERT_EQ(my_str_stats_get(nullptr), NULL_PTR_ERR);
+    ASSERT_EQ(my_str_stats_get_thread(nullptr), NULL_PTR_ERR);
+}
+
+TEST_F(ClassDeclaration, stats_counters) {
+    StatsScope scope;
+    ASSERT_EQ(my_str_stats_enabled(), 1);
+    my_str_stats_t stats;
+
+    // registering the counters of this thread may allocate, so do it before measuring
+    ASSERT_EQ(my_str_stats_get_thread(&stats), 0);
+    ASSERT_EQ(total_allocations(stats), 0);
+
+    // every heap buffer of the library is seen, and nothing else.
+    // big stays below my_str_mremap_threshold, so it comes from operator new too
+    size_t allocations = allocations_count;
+    my_str_t small{"short"};
+    my_str_t str{100, 'a'};
+    my_str_t big{my_str_mremap_threshold / 2, 'b'};
+    ASSERT_EQ(my_str_stats_get(&stats), 0);
+    ASSERT_EQ(total_allocations(stats), allocations_count - allocations);
+    ASSERT_EQ(total_allocations(stats), 2);
+    ASSERT_EQ(stats.allocations[my_str_stats_size_class(str.capacity() + 1)], 1);
+    ASSERT_EQ(stats.allocations[my_str_stats_size_class(big.capacity() + 1)], 1);
+    ASSERT_EQ(stats.allocated_bytes, str.capacity() + 1 + big.capacity() + 1);
+
+    // mapped buffers bypass operator new, but they are still counted
+    my_str_stats_t before = stats;
+    allocations = allocations_count;
+    my_str_t mapped{my_str_mremap_threshold * 2, 'm'};
+    ASSERT_EQ(allocations_count, allocations);
+    ASSERT_EQ(my_str_stats_get(&stats), 0);
+    ASSERT_EQ(total_allocations(stats), 3);
+    size_t mapped_class = my_str_stats_size_class(mapped.capacity() + 1);
+    ASSERT_EQ(stats.allocations[mapped_class], before.allocations[mapped_class] + 1);
+    ASSERT_EQ(stats.allocated_bytes, before.allocated_bytes + mapped.capacity() + 1);
+
+    // reserve either fits or moves the string to a new buffer
+    str.reserve(50);
+    str.reserve(str.capacity());
+    str.reserve(1000);
+    ASSERT_EQ(my_str_stats_get(&stats), 0);
+    ASSERT_EQ(stats.reserve_hits, 2);
+    ASSERT_EQ(stats.reserve_misses, 1);
+    ASSERT_EQ(stats.reallocations, 1);
+    ASSERT_GE(stats.copied_bytes, 100);
+    ASSERT_LE(stats.copied_bytes, 101);
+
+    // only the tail behind the edit is moved
+    my_str_stats_reset();
+    str.insert(0, "xy");
+    str.erase(0, 2);
+    str.insert(90, "xy");
+    str.append('c');
+    ASSERT_EQ(my_str_stats_get(&stats), 0);
+    ASSERT_EQ(stats.moved_bytes, 100 + 100 + 10);
+    ASSERT_EQ(total_allocations(stats), 0);
+    ASSERT_EQ(stats.reallocations, 0);
+}
+
+TEST_F(ClassDeclaration, stats_file_time) {
+    StatsScope scope;
+    unique_file_ptr file{std::tmpfile(), fclose};
+    my_str_t str{1 << 20, 'f'};
+    ASSERT_EQ(my_str_write_file(&str, file.get()), 0);
+    std::rewind(file.get());
+    ASSERT_EQ(my_str_read_file(&str, file.get()), 0);
+    std::rewind(file.get());
+    ASSERT_EQ(my_str_read_file_delim(&str, file.get(), '\n'), 0);
+
+    my_str_stats_t stats;
+    ASSERT_EQ(my_str_stats_get(&stats), 0);
+    ASSERT_EQ(stats.write_file_calls, 1);
+    ASSERT_EQ(stats.read_file_calls, 2);
+    ASSERT_GT(stats.read_file_ns, 0);
+    ASSERT_GT(stats.write_file_ns, 0);
+
+    // failed calls are timed too
+    ASSERT_EQ(my_str_read_file(&str, nullptr), NULL_PTR_ERR);
+    ASSERT_EQ(my_str_stats_get(&stats), 0);
+    ASSERT_EQ(stats.read_file_calls, 3);
+}
+
+TEST_F(ClassDeclaration, stats_threads) {
+    StatsScope scope;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> failures{0};
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&failures] {
+            std::vector<my_str_t> strings;
+            for (int i = 0; i < 1000; ++i)
+                strings.emplace_back(my_str_t{100, 'x'});
+            // each thread counts for itself
+            my_str_stats_t own;
+            if (my_str_stats_get_thread(&own) != 0 || total_allocations(own) != 1000)
+                ++failures;
+        });
+    }
+    for (auto &thread: threads)
+        thread.join();
+    ASSERT_EQ(failures, 0);
+
+    // threads that already exited are still in the totals
+    my_str_stats_t stats;
+    ASSERT_EQ(my_str_stats_get(&stats), 0);
+    ASSERT_EQ(total_allocations(stats), 4000);
+    ASSERT_EQ(my_str_stats_get_thread(&stats), 0);
+    ASSERT_EQ(total_allocations(stats), 0);
+
+    my_str_stats_reset();
+    ASSERT_EQ(my_str_stats_get(&stats), 0);
+    ASSERT_EQ(total_allocations(stats), 0);
+}
+
+// every byte value, including zeros and the ones above 127
+static inline std::string make_random_bytes(size_t size, unsigned seed) {
+    std::string bytes;
+    for (size_t i = 0; i < size; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        bytes.push_back(static_cast<char>(seed >> 16));
+    }
+    return bytes;
+}
+
+// applies `transform` to my_str_t and `expected` to std::string for every size up to 300, so every
+// tail of a word or vector loop is covered. The string must stay in its buffer and match byte for byte
+template<typename Transform, typename Expected>
+static inline void check_transform(Transform transform, Expected expected) {
+    for (size_t size = 0; size < 300; ++size) {
+        std::string text = make_random_bytes(size, static_cast<unsigned>(size * 31 + 1));
+        my_str_t str{text};
+
+        const char *data = str.c_str();
+        const size_t capacity = str.capacity();
+        size_t allocations = allocations_count;
+        transform(str);
+        expected(text);
+        ASSERT_EQ(allocations_count - allocations, 0);
+        ASSERT_EQ(str.c_str(), data);
+        ASSERT_EQ(str.capacity(), capacity);
+        ASSERT_EQ(str.size(), text.size()) << size;
+        ASSERT_EQ(std::memcmp(str.c_str(), text.data(), text.size()), 0) << size;
+        ASSERT_EQ(str.c_str()[str.size()], '\0');
+    }
+}
+
+TEST_F(ClassDeclaration, transform_case) {
+    // ASCII only, other bytes are left alone
+    check_transform([](my_str_t &str) { str.to_lower(); }, [](std::string &text) {
+        for (auto &symbol: text)
+            if (symbol >= 'A' && symbol <= 'Z')
+                symbol = static_cast<char>(symbol - 'A' + 'a');
+    });
+    check_transform([](my_str_t &str) { str.to_upper(); }, [](std::string &text) {
+        for (auto &symbol: text)
+            if (symbol >= 'a' && symbol <= 'z')
+                symbol = static_cast<char>(symbol - 'a' + 'A');
+    });
+
+    my_str_t str{"Hello, World! \xc0\xe0 @[`{"};
+    str.to_upper();
+    ASSERT_STREQ(str.c_str(), "HELLO, WORLD! \xc0\xe0 @[`{");
+    str.to_lower();
+    ASSERT_STREQ(str.c_str(), "hello, world! \xc0\xe0 @[`{");
+}
+
+TEST_F(ClassDeclaration, transform_replace_and_translate) {
+    check_transform([](my_str_t &str) { str.replace_all('\0', ' '); },
+                    [](std::string &text) { std::replace(text.begin(), text.end(), '\0', ' '); });
+    check_transform([](my_str_t &str) { str.replace_all('\xff', 'x'); },
+                    [](std::string &text) { std::replace(text.begin(), text.end(), '\xff', 'x'); });
+
+    // rot13 for letters, digits to '#', everything else unchanged
+    static char table[256];
+    for (int i = 0; i < 256; ++i) {
+        char symbol = static_cast<char>(i);
+        if (symbol >= 'a' && symbol <= 'z')
+            symbol = static_cast<char>('a' + (symbol - 'a' + 13) % 26);
+        else if (symbol >= 'A' && symbol <= 'Z')
+            symbol = static_cast<char>('A' + (symbol - 'A' + 13) % 26);
+        else if (symbol >= '0' && symbol <= '9')
+            symbol = '#';
+        table[i] = symbol;
+    }
+    check_transform([](my_str_t &str) { str.translate(table); }, [](std::string &text) {
+        for (auto &symbol: text)
+            symbol = table[static_cast<unsigned char>(symbol)];
+    });
+
+    my_str_t str{"Uryyb 2024"};
+    str.translate(table);
+    ASSERT_STREQ(str.c_str(), "Hello ####");
+    str.replace_all('l', 'L');
+    ASSERT_STREQ(str.c_str(), "HeLLo ####");
+}
+
+TEST_F(ClassDeclaration, transform_trim) {
+    // random texts are mostly not whitespace, so pad them
+    const std::string blanks{" \t\n\v\f\r"};
+    check_transform([](my_str_t &str) { str.trim(); }, [&blanks](std::string &text) {
+        text.erase(0, std::min(text.find_first_not_of(blanks), text.size()));
+        text.erase(text.find_last_not_of(blanks) + 1);
+    });
+    for (size_t pad = 0; pad < 70; ++pad) {
+        const std::string middle = "a \t b";
+        my_str_t str{std::string(pad, ' ') + middle + std::string(pad, '\n')};
+        const char *data = str.c_str();
+        str.trim();
+        ASSERT_EQ(str.c_str(), data);
+        ASSERT_STREQ(str.c_str(), middle.c_str());
+    }
+
+    my_str_t blank{" \t\r\n "};
+    blank.trim();
+    ASSERT_EQ(blank.size(), 0);
+    ASSERT_STREQ(blank.c_str(), "");
+
+    // any set of characters
+    my_str_t str{"--==value==--"};
+    str.trim(my_char_set_t{"-="});
+    ASSERT_STREQ(str.c_str(), "value");
+    str.trim(my_char_set_t{"valu"});
+    ASSERT_STREQ(str.c_str(), "e");
+}
+
+template<typename Range>
+static inline std::vector<std::string> collect_fields(const Range &range) {
+    std::vector<std::string> fields;
+    for (my_str_view_t field: range)
+        fields.emplace_back(field.data(), field.size());
+    return fields;
+}
+
+// n delimiters always give n + 1 fields, empty ones included
+template<typename IsDelim>
+static inline std::vector<std::string> reference_split(const std::string &text, IsDelim is_delim) {
+    std::vector<std::string> fields(1);
+    for (char symbol: text) {
+        if (is_delim(symbol))
+            fields.emplace_back();
+        else
+            fields.back().push_back(symbol);
+    }
+    return fields;
+}
+
+static inline int is_split_symbol(int symbol) {
+    return symbol == ';' || symbol == '\0';
+}
+
+TEST_F(ClassDeclaration, split) {
+    const my_str_t record{"a,b,,c,"};
+    const std::vector<std::string> expected{"a", "b", "", "c", ""};
+    ASSERT_EQ(collect_fields(record.split(',')), expected);
+
+    // fields are views into the string itself, iterators may outlive the temporary range
+    auto field = record.split(',').begin();
+    ASSERT_EQ(field->data(), record.c_str());
+    ++field;
+    ASSERT_EQ(field->data(), record.c_str() + 2);
+    ASSERT_EQ(*field, my_str_view_t{"b"});
+
+    const my_str_t no_delimiter{"abc"};
+    const my_str_t only_delimiter{","};
+    ASSERT_EQ(collect_fields(string_empty.split(',')), std::vector<std::string>{""});
+    ASSERT_EQ(collect_fields(no_delimiter.split(',')), std::vector<std::string>{"abc"});
+    ASSERT_EQ(collect_fields(only_delimiter.split(',')), (std::vector<std::string>{"", ""}));
+
+    // views can be split as well, and the range works with the standard algorithms
+    const my_str_view_t line{"key=value;other=1;x"};
+    ASSERT_EQ(collect_fields(line.split(';')), (std::vector<std::string>{"key=value", "other=1", "x"}));
+    const auto range = line.split(';');
+    ASSERT_EQ(std::distance(range.begin(), range.end()), 3);
+    ASSERT_EQ(std::count_if(range.begin(), range.end(), [](my_str_view_t f) { return f.find('=', 0) != SIZE_MAX; }), 2);
+}
+
+template<typename T, typename = void>
+struct has_split : std::false_type {};
+template<typename T>
+struct has_split<T, std::void_t<decltype(std::declval<T>().split(','))>> : std::true_type {};
+
+// like view(), splitting a temporary my_str_t would hand out views of its dying inline buffer
+static_assert(has_split<my_str_t &>::value && has_split<const my_str_t &>::value);
+static_assert(!has_split<my_str_t>::value && !has_split<const my_str_t>::value);
+// a view does not own the characters, so a temporary view splits fine
+static_assert(has_split<my_str_view_t>::value);
+
+TEST_F(ClassDeclaration, split_matches_reference) {
+    const my_char_set_t blanks{" \t\n"};
+    for (unsigned seed = 1; seed <= 20; ++seed) {
+        // long runs of non-delimiters and runs of delimiters
+        std::string text = make_random_text(seed * 97, "abcdefghijklmnopqrstuvwxyz0123456789, \t\n;", seed);
+        text[seed % text.size()] = '\0';
+        const my_str_t str{text};
+
+        ASSERT_EQ(collect_fields(str.split(',')), reference_split(text, [](char s) { return s == ','; })) << seed;
+        ASSERT_EQ(collect_fields(str.split(blanks)), reference_split(text, [&blanks](char s) {
+            return blanks.contains(s);
+        })) << seed;
+        ASSERT_EQ(collect_fields(str.split(is_split_symbol)), reference_split(text, [](char s) {
+            return is_split_symbol(static_cast<unsigned char>(s)) != 0;
+        })) << seed;
+        ASSERT_EQ(collect_fields(str.split('\0')), reference_split(text, [](char s) { return s == '\0'; })) << seed;
+    }
+}
+
+TEST_F(ClassDeclaration, split_without_allocations) {
+    // 10 MB of CSV-like lines, "field,field,...,field\n"
+    my_str_t buffer{""};
+    buffer.reserve(10 << 20);
+    size_t expected_fields = 0;
+    const std::string line = "1234,some name,,3.14,last\n";
+    while (buffer.size() + line.size() < buffer.capacity()) {
+        buffer.append(line.c_str());
+        expected_fields += 5;
+    }
+
+    const size_t allocations = allocations_count;
+    size_t fields = 0;
+    size_t total_size = 0;
+    for (my_str_view_t row: buffer.split('\n')) {
+        for (my_str_view_t field: row.split(',')) {
+            total_size += field.size();
+            ++fields;
+        }
+    }
+    size_t words = 0;
+    for (my_str_view_t word: buffer.split(my_char_set_t{" ,\n"}))
+        words += !word.empty();
+    ASSERT_EQ(allocations_count - allocations, 0);
+
+    // the last line ends with '\n', so there is one more, empty, row
+    ASSERT_EQ(fields, expected_fields + 1);
+    ASSERT_EQ(total_size, expected_fields / 5 * (line.size() - 5));
+    ASSERT_EQ(words, expected_fields / 5 * 5);
+}
+
+TEST_F(ClassDeclaration, from_chars_integers) {
+    const my_str_t str{"a=17;b=-3;c=ff;d=123abc"};
+    int value = 0;
+
+    // parsing starts at the given index and stops at the first character that does not fit
+    auto result = str.from_chars(value, 2);
+    ASSERT_EQ(result.ec, std::errc{});
+    ASSERT_EQ(result.pos, 4);
+    ASSERT_EQ(value, 17);
+    result = str.from_chars(value, 7);
+    ASSERT_EQ(result.ec, std::errc{});
+    ASSERT_EQ(value, -3);
+    result = str.from_chars(value, 12, 16);
+    ASSERT_EQ(result.ec, std::errc{});
+    ASSERT_EQ(result.pos, 14);
+    ASSERT_EQ(value, 255);
+    result = str.from_chars(value, 17);
+    ASSERT_EQ(result.pos, 20);
+    ASSERT_EQ(value, 123);
+
+    // like std::from_chars: no leading blanks or '+', the value is untouched on failure
+    value = 5;
+    for (size_t idx: {size_t{0}, size_t{1}, str.size()}) {
+        result = str.from_chars(value, idx);
+        ASSERT_EQ(result.ec, std::errc::invalid_argument);
+        ASSERT_EQ(result.pos, idx);
+        ASSERT_EQ(value, 5);
+    }
+    ASSERT_EQ(my_str_t{" 1"}.from_chars(value).ec, std::errc::invalid_argument);
+    ASSERT_EQ(my_str_t{"+1"}.from_chars(value).ec, std::errc::invalid_argument);
+    ASSERT_THROW(str.from_chars(value, str.size() + 1), std::out_of_range);
+
+    // overflow consumes all the digits and reports the range error
+    int64_t big = 0;
+    result = my_str_t{"99999999999999999999,"}.from_chars(big);
+    ASSERT_EQ(result.ec, std::errc::result_out_of_range);
+    ASSERT_EQ(result.pos, 20);
+    result = my_str_t{"-9223372036854775808"}.from_chars(big);
+    ASSERT_EQ(result.ec, std::errc{});
+    ASSERT_EQ(big, INT64_MIN);
+    uint8_t small = 0;
+    ASSERT_EQ(my_str_t{"256"}.from_chars(small).ec, std::errc::result_out_of_range);
+
+    // the end of a view is respected even when the buffer goes on
+    const my_str_t digits{"123456"};
+    result = digits.substr_view(0, 3).from_chars(value);
+    ASSERT_EQ(result.pos, 3);
+    ASSERT_EQ(value, 123);
+}
+
+TEST_F(ClassDeclaration, from_chars_floating_point) {
+    double value = 0;
+    auto result = my_str_t{"x=3.25e2;"}.from_chars(value, 2);
+    ASSERT_EQ(result.ec, std::errc{});
+    ASSERT_EQ(result.pos, 8);
+    ASSERT_EQ(value, 325.0);
+
+    // '.' is the decimal point whatever the locale is
+    ASSERT_EQ(my_str_t{"1.5"}.from_chars(value).ec, std::errc{});
+    ASSERT_EQ(value, 1.5);
+    ASSERT_EQ(my_str_t{"-inf"}.from_chars(value).ec, std::errc{});
+    ASSERT_TRUE(std::isinf(value) && value < 0);
+    ASSERT_EQ(my_str_t{"nan"}.from_chars(value).ec, std::errc{});
+    ASSERT_TRUE(std::isnan(value));
+    ASSERT_EQ(my_str_t{"1e400"}.from_chars(value).ec, std::errc::result_out_of_range);
+    ASSERT_EQ(my_str_t{"e5"}.from_chars(value).ec, std::errc::invalid_argument);
+
+    result = my_str_t{"1e5"}.from_chars(value, 0, std::chars_format::fixed);
+    ASSERT_EQ(result.pos, 1);
+    ASSERT_EQ(value, 1.0);
+    float single = 0;
+    ASSERT_EQ(my_str_t{"0.1"}.from_chars(single).ec, std::errc{});
+    ASSERT_EQ(single, 0.1f);
+
+    // shortest output of append_number reads back to the same bits, without allocating
+    my_str_t buffer{""};
+    buffer.reserve(64);
+    unsigned seed = 42;
+    for (int i = 0; i < 10000; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        uint64_t bits = (static_cast<uint64_t>(seed) << 32) ^ (seed * 2654435761u);
+        double original;
+        std::memcpy(&original, &bits, sizeof(original));
+        if (std::isnan(original))
+            continue;
+        buffer.clear();
+        size_t allocations = allocations_count;
+        buffer.append_number(original);
+        double parsed = 0;
+        result = buffer.from_chars(parsed);
+        ASSERT_EQ(allocations_count - allocations, 0);
+        ASSERT_EQ(result.ec, std::errc{});
+        ASSERT_EQ(result.pos, buffer.size());
+        ASSERT_EQ(std::memcmp(&parsed, &original, sizeof(parsed)), 0) << buffer.c_str();
+    }
+}
+
+TEST_F(ClassDeclaration, append_number_formats) {
+    my_str_t str{""};
+    str.append_number(255, 16);
+    str.append(',');
+    str.append_number(-5, 2);
+    str.append(',');
+    str.append_number(UINT64_MAX, 36);
+    ASSERT_STREQ(str.c_str(), "ff,-101,3w5e11264sgsf");
+
+    // the same text as std::to_chars with the same format and precision
+    struct case_t {
+        double value;
+        std::chars_format format;
+        int precision;
+    };
+    const case_t cases[] = {
+            {3.14159, std::chars_format::fixed, 2},
+            {3.14159, std::chars_format::scientific, 3},
+            {3.14159, std::chars_format::general, 4},
+            {1e21, std::chars_format::fixed, 0},
+            {1e-7, std::chars_format::fixed, 10},
+            {-0.0, std::chars_format::scientific, 0},
+            {123.456, std::chars_format::hex, -1},
+            {1e300, std::chars_format::fixed, -1},
+    };
+    for (const auto &c: cases) {
+        char expected[512];
+        auto end = c.precision < 0 ? std::to_chars(expected, expected + sizeof(expected), c.value, c.format).ptr
+                                   : std::to_chars(expected, expected + sizeof(expected), c.value, c.format,
+                                                   c.precision).ptr;
+        str.clear();
+        if (c.precision < 0)
+            str.append_number(c.value, c.format);
+        else
+            str.append_number(c.value, c.format, c.precision);
+        ASSERT_EQ(std::string(str.c_str(), str.size()), std::string(expected, end));
+    }
+
+    my_str_t fixed{""};
+    fixed.append_number(2.5, std::chars_format::fixed, 3);
+    ASSERT_STREQ(fixed.c_str(), "2.500");
+}